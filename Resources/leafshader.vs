@@ -7,11 +7,27 @@ layout (location=2) in vec2	texcoords;
 uniform mat4 mvp;
 uniform mat3 normalMat;
 
+// our packed vertex formats store our normals octahedral encoded and our texture coordinates scaled down
+uniform bool octNormals;
+uniform vec2 texScale;
+
+vec3 decodeNormal(vec3 pNormal) {
+	if (!octNormals) {
+		return pNormal;
+	}
+	
+	vec3 n = vec3(pNormal.xy, 1.0 - abs(pNormal.x) - abs(pNormal.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
 out vec3 N;
 out vec2 T;
 
 void main() {
 	gl_Position = mvp * vec4(vertices, 1.0);
-	N = normalize(normalMat * normals);
-	T = texcoords;
+	N = normalize(normalMat * decodeNormal(normals));
+	T = texcoords * texScale;
 }
\ No newline at end of file
@@ -6,6 +6,22 @@ layout (location=2) in vec2	texcoords;
 
 uniform mat4 mvp;
 
+// our packed vertex formats store our normals octahedral encoded and our texture coordinates scaled down
+uniform bool octNormals;
+uniform vec2 texScale;
+
+vec3 decodeNormal(vec3 pNormal) {
+	if (!octNormals) {
+		return pNormal;
+	}
+	
+	vec3 n = vec3(pNormal.xy, 1.0 - abs(pNormal.x) - abs(pNormal.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
 out VS_OUT {
 	vec3 Vp;
 	vec3 N;
@@ -17,6 +33,6 @@ void main() {
 	gl_Position = V;
 	V = mvp * V;
 	vs_out.Vp = V.xyz / V.w;
-	vs_out.N = normals;
-	vs_out.T = texcoords;
+	vs_out.N = decodeNormal(normals);
+	vs_out.T = texcoords * texScale;
 }
\ No newline at end of file
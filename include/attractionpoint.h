@@ -13,6 +13,7 @@ class attractionPoint {
 public:
 	vec3 position;
 	unsigned long closestVertice;
+	unsigned long firstVertice;									// first vertex this point was tested against, older vertices are never considered
 
 	attractionPoint();
 	attractionPoint(float pX, float pY, float pZ);
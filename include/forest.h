@@ -0,0 +1,123 @@
+/********************************************************************
+ * forest generates a whole set of trees in parallel
+ *
+ * Each tree is described by a treespec, the trees are built as
+ * separate jobs on our thread pool so a forest of N trees keeps N
+ * cores busy. Meshes are handed to a callback as each tree finishes.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef foresth
+#define foresth
+
+#include <pthread.h>
+#include <vector>
+
+#include "vec2.h"
+#include "vec3.h"
+#include "threadpool.h"
+#include "treebuilder.h"
+#include "treemesh.h"
+
+class treecache;
+
+// parameters for one cloud of attraction points, see treebuilder::generateAttractionPoints
+class cloudspec {
+public:
+	unsigned long	numOfPoints;
+	float			outerRadius;
+	float			innerRadius;
+	float			aspect;
+	float			offsetY;
+	
+	cloudspec();
+	cloudspec(unsigned long pNumOfPoints, float pOuterRadius, float pInnerRadius, float pAspect, float pOffsetY);
+};
+
+// parameters for one stage of growing our tree, we call treebuilder::doIteration with these until it returns false
+class growspec {
+public:
+	float			maxDistance;
+	float			branchSize;
+	float			cutOffDistance;
+	vec3			bias;
+	
+	growspec();
+	growspec(float pMaxDistance, float pBranchSize, float pCutOffDistance, vec3 pBias);
+};
+
+// everything we need to generate one tree, defaults to the same tree as our interactive version
+class treespec {
+public:
+	unsigned long long		seed;								// seed for our random numbers, see treebuilder::setSeed
+	vec3					trunk;								// end of the branch we start growing from
+	std::vector<cloudspec>	clouds;								// our attraction point clouds
+	std::vector<growspec>	stages;								// our growth stages
+	bool					optimise;							// if true we call optimiseNodes before building our mesh
+	float					minRadius;							// see treebuilder::setMinRadius
+	float					radiusFactor;						// see treebuilder::setRadiusFactor
+	vec2					leafSize;							// see treebuilder::setLeafSize
+	searchModes				searchMode;							// see treebuilder::setSearchMode
+	bool					optimiseVertexCache;				// see treebuilder::setOptimiseVertexCache
+	
+	treespec();
+};
+
+// what happened while buildTree built a single tree, times are in milliseconds
+class buildreport {
+public:
+	double					pointsTime;							// generating our attraction points
+	double					growTime;							// all our growth stages
+	double					optimiseTime;						// optimiseNodes, 0 if our spec doesn't optimise
+	double					modelTime;							// createModel and taking our mesh
+	unsigned long			iterations;							// number of calls to doIteration that grew our tree
+	unsigned long			grownNodes;							// number of nodes after growing our tree
+	unsigned long			numOfNodes;							// number of nodes our model was built from
+	unsigned long			peakMemory;							// see treebuilder::peakMemory
+	cachestats				cacheStats;							// see treebuilder::cacheStats
+	treestats				stats;								// see treebuilder::stats
+	
+	buildreport();
+};
+
+class forest {
+public:
+	// called for each tree that is finished, calls are never made at the same time so this doesn't need to be thread safe
+	typedef void (*meshCallback)(void* pData, unsigned long pTree, treemesh& pMesh);
+
+private:
+	int							mNumThreads;					// number of threads in our thread pool (0 = one per core)
+	threadpool*					mThreadPool;					// our thread pool, created when we first need it
+	pthread_mutex_t				mCallbackMutex;					// makes sure only one thread calls our callback at a time
+	treecache*					mCache;							// if set we get our trees from this cache
+	
+	// everything our workers need to generate our trees
+	class forestJob {
+	public:
+		forest*							owner;
+		const std::vector<treespec>*	specs;
+		meshCallback					callback;
+		void*							data;
+	};
+	
+	static void runTreeJob(void* pData, unsigned long pJob, int pWorker);
+
+public:
+	forest(int pNumThreads = 0);
+	~forest();
+	
+	// properties
+	int numThreads();
+	void setNumThreads(int pNumThreads);
+	treecache* cache();
+	void setCache(treecache* pCache);
+	
+	// interface
+	void generate(const std::vector<treespec>& pSpecs, meshCallback pCallback, void* pData);
+	
+	// helpers
+	static void buildTree(const treespec& pSpec, treemesh& pMesh, int pNumThreads = -1, buildreport* pReport = NULL);
+};
+
+#endif
@@ -0,0 +1,50 @@
+/********************************************************************
+ * indexbuffer holds our elements as 16 bit indices ready to be
+ * uploaded to the GPU
+ *
+ * Our elements store 32 bit indices into our whole vertex array. Most
+ * trees have fewer than 65536 vertices so 16 bits is all we need, for
+ * larger trees we split our elements into chunks that each use a
+ * range of at most 65536 vertices and store their indices relative to
+ * the first vertex of that range. Each chunk is drawn separately with
+ * that vertex as its base vertex.
+ * If our elements jump around our vertex array so much we'd need lots
+ * of tiny chunks we don't bother and keep using 32 bit indices.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef indexbufferh
+#define indexbufferh
+
+#include <vector>
+
+#define		INDEXBUFFER_MAX_RANGE		65536					// number of vertices a 16 bit index can reach
+#define		INDEXBUFFER_MIN_CHUNK_SIZE	3072					// average number of indices our chunks need or we stay 32 bit
+
+// a range of our indices that is drawn in one go
+class indexchunk {
+public:
+	unsigned long				first;							// our first index in our buffer
+	unsigned long				count;							// number of indices in our chunk
+	unsigned long				baseVertex;						// added to each index in our chunk to get our vertex
+};
+
+class indexbuffer {
+private:
+	std::vector<unsigned short>	mIndices;						// our indices, relative to the base vertex of their chunk
+	std::vector<indexchunk>		mChunks;						// our chunks
+
+public:
+	// properties
+	unsigned long size() const;
+	const unsigned short* data() const;
+	const std::vector<indexchunk>& chunks() const;
+	unsigned long memoryUsed() const;
+
+	// interface
+	void clear();
+	bool build(const unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize);
+};
+
+#endif
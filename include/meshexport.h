@@ -0,0 +1,68 @@
+/********************************************************************
+ * meshexport writes our tree meshes to standard file formats
+ *
+ * We stream straight from our arrays into a fixed size buffer that we
+ * write to our file descriptor whenever it fills up so we never build
+ * the whole file in memory. Numbers are formatted by hand as printf
+ * is by far the slowest part of writing a large OBJ file.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef meshexporth
+#define meshexporth
+
+#include <string>
+
+#include "treemesh.h"
+
+#define		EXPORTBUFFER_SIZE		65536
+
+// buffers what we write to a file descriptor
+class exportbuffer {
+private:
+	int				mFile;										// file descriptor we write to
+	unsigned long	mUsed;										// number of bytes in our buffer
+	bool			mFailed;									// true once a write has failed
+	char			mBuffer[EXPORTBUFFER_SIZE];					// our buffer
+
+	void writeAll(const char* pData, unsigned long pSize);
+
+public:
+	exportbuffer(int pFile);
+	~exportbuffer();
+
+	// properties
+	bool failed() const;
+
+	// interface
+	void put(const void* pData, unsigned long pSize);
+	void put(const char* pText);
+	void putChar(char pChar);
+	void putUnsigned(unsigned long pValue);
+	void putFloat(float pValue);
+	bool flush();
+
+	// helpers
+	static int formatUnsigned(unsigned long pValue, char* pOut);
+	static int formatFloat(float pValue, char* pOut);
+};
+
+// our exporters
+enum exportFormats {
+	export_obj,													// Wavefront OBJ, text
+	export_ply,													// Stanford PLY, binary
+	export_glb													// binary glTF 2.0
+};
+
+class meshexport {
+public:
+	static bool writeOBJ(const treemesh& pMesh, int pFile);
+	static bool writePLY(const treemesh& pMesh, int pFile);
+	static bool writeGLB(const treemesh& pMesh, int pFile);
+	static bool write(const treemesh& pMesh, int pFile, exportFormats pFormat);
+	static bool write(const treemesh& pMesh, const std::string& pFileName, exportFormats pFormat);
+	static bool formatFromFileName(const std::string& pFileName, exportFormats& pFormat);
+};
+
+#endif
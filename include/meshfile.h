@@ -0,0 +1,115 @@
+/********************************************************************
+ * meshfile reads and writes our binary tree mesh format
+ *
+ * The file starts with a header and a table of sections, each section
+ * holds one array of our mesh exactly as we have it in memory and
+ * starts on a 64 byte boundary. We map the file into memory and hand
+ * out pointers straight into it so loading a tree doesn't parse or
+ * copy anything, the arrays can be passed to glBufferData as is.
+ *
+ * All values are stored in the byte order of the machine that wrote
+ * the file, we refuse to open files written in another byte order.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef meshfileh
+#define meshfileh
+
+#include <string>
+#include <vector>
+
+#include "vec2.h"
+#include "vec3.h"
+#include "treemesh.h"
+#include "treenode.h"
+
+#define		MESHFILE_VERSION		1
+#define		MESHFILE_ALIGNMENT		64
+
+// the sections in our file, new sections may be added but existing numbers never change
+enum meshSections {
+	section_vertices = 1,										// vec3 per vertex
+	section_normals = 2,										// vec3 per vertex
+	section_texcoords = 3,										// vec2 per vertex
+	section_tree_elements = 4,									// quad (4 x 32 bit index) per bark patch
+	section_leaf_elements = 5,									// triangle (3 x 32 bit index) per leaf triangle
+	section_skeleton_vertices = 6,								// vec3 per skeleton vertex
+	section_skeleton_nodes = 7,									// meshnode per skeleton node
+	section_key = 8												// bytes identifying our tree, used by treecache
+};
+
+// a node of our skeleton as stored in our file, a treenode with fixed size fields
+class meshnode {
+public:
+	unsigned int	a;											// index of the skeleton vertex where our node starts
+	unsigned int	b;											// index of the skeleton vertex where our node ends
+	int				parent;										// index of our parent node (-1 if this is a root node)
+	unsigned int	childcount;									// number of children (including their children)
+};
+
+// an entry in our section table
+class meshsection {
+public:
+	unsigned int		type;									// one of meshSections
+	unsigned int		elementSize;							// size of one element in bytes
+	unsigned long long	offset;									// offset of our data from the start of our file, a multiple of MESHFILE_ALIGNMENT
+	unsigned long long	count;									// number of elements
+};
+
+// the header at the start of our file, followed by our section table
+class meshheader {
+public:
+	char				magic[8];								// "TREEMESH"
+	unsigned int		version;								// MESHFILE_VERSION
+	unsigned int		byteOrder;								// 0x01020304 as written by the machine that wrote our file
+	unsigned int		numSections;							// number of entries in our section table
+	unsigned int		reserved;								// always 0
+};
+
+class meshfile {
+private:
+	void*					mData;							// our mapped file
+	unsigned long long		mSize;							// size of our mapped file
+	const meshsection*		mSections;						// our section table
+	unsigned int			mNumSections;					// number of entries in our section table
+	
+	const meshsection* findSection(unsigned int pType, unsigned int pElementSize) const;
+	const void* sectionData(unsigned int pType, unsigned int pElementSize, unsigned long& pCount) const;
+	
+	// we can't be copied
+	meshfile(const meshfile& pCopy);
+	meshfile& operator=(const meshfile& pCopy);
+
+public:
+	meshfile();
+	~meshfile();
+	
+	// properties
+	bool isOpen() const;
+	unsigned long numOfVertices() const;
+	const vec3* vertices() const;
+	const vec3* normals() const;
+	const vec2* texCoords() const;
+	unsigned long numOfTreeElements() const;
+	const quad* treeElements() const;
+	unsigned long numOfLeafElements() const;
+	const triangle* leafElements() const;
+	unsigned long numOfSkeletonVertices() const;
+	const vec3* skeletonVertices() const;
+	unsigned long numOfSkeletonNodes() const;
+	const meshnode* skeletonNodes() const;
+	unsigned long keySize() const;
+	const unsigned char* key() const;
+	
+	// interface
+	bool open(const std::string& pFileName);
+	void close();
+	bool validate() const;
+	void copyTo(treemesh& pMesh) const;
+	
+	// helpers
+	static bool write(const std::string& pFileName, const treemesh& pMesh, const std::vector<unsigned char>* pKey = NULL);
+};
+
+#endif
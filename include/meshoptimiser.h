@@ -0,0 +1,63 @@
+/********************************************************************
+ * meshoptimiser reorders our meshes so the GPU renders them faster
+ *
+ * We reorder our primitives for the post transform vertex cache using
+ * Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for
+ * Vertex Locality and Reduced Overdraw", 2007). It runs in linear
+ * time and works for any number of vertices per primitive so we use
+ * it for both our bark patches and our leaf triangles. The clusters
+ * Tipsify produces are then sorted so primitives facing away from
+ * the center of our mesh are drawn first which reduces overdraw.
+ * Finally our vertices can be renumbered in the order they are first
+ * used so the GPU also fetches them in order.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef meshoptimiserh
+#define meshoptimiserh
+
+#include <algorithm>
+#include <vector>
+
+#include "vec3.h"
+
+#define		MESHOPTIMISER_CACHE_SIZE	16						// number of vertices in the vertex cache we optimise for
+#define		MESHOPTIMISER_UNUSED		((unsigned long) -1)	// marks vertices fetchOrder hasn't given a new index yet
+
+// average cache miss ratio (ACMR) of our mesh before and after we optimised it, this is the number of
+// vertices our GPU transforms for each primitive so lower is better
+class cachestats {
+public:
+	float				treeBefore;								// our bark patches
+	float				treeAfter;
+	float				leafBefore;								// our leaf triangles
+	float				leafAfter;
+
+	cachestats();
+};
+
+class meshoptimiser {
+private:
+	// a cluster of primitives and the value we sort it on
+	class cluster {
+	public:
+		unsigned long	first;									// first primitive in our cluster
+		unsigned long	count;									// number of primitives in our cluster
+		float			sortKey;								// higher is drawn first
+
+		bool operator<(const cluster& pOther) const;
+	};
+
+	static long nextVertex(const std::vector<unsigned int>& pCandidates, const std::vector<unsigned int>& pLive, const std::vector<unsigned int>& pCacheTime, unsigned int pTime, unsigned long pCacheSize);
+	static void sortClusters(unsigned int* pIndices, int pPrimitiveSize, const std::vector<vec3>& pVertices, std::vector<cluster>& pClusters);
+
+public:
+	// interface
+	static float acmr(const unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize, unsigned long pNumOfVertices, unsigned long pCacheSize = MESHOPTIMISER_CACHE_SIZE);
+	static void optimiseOrder(unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize, const std::vector<vec3>& pVertices, unsigned long pCacheSize = MESHOPTIMISER_CACHE_SIZE);
+	static unsigned long fetchOrder(const unsigned int* pIndices, unsigned long pNumOfIndices, std::vector<unsigned long>& pNewIndex, unsigned long pNext);
+	static void remapIndices(unsigned int* pIndices, unsigned long pNumOfIndices, const std::vector<unsigned long>& pNewIndex);
+};
+
+#endif
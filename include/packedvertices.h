@@ -0,0 +1,68 @@
+/********************************************************************
+ * packedvertices holds our vertices interleaved in a compact layout
+ * ready to be uploaded to the GPU
+ *
+ * Each vertex is a position (3 floats or 3 half floats padded to 4),
+ * an octahedral encoded normal as 2 snorm16 values and a texture
+ * coordinate as 2 unorm16 values. That gives us 20 or 16 bytes per
+ * vertex instead of the 32 bytes of our separate arrays.
+ * Our bark texture repeats along our branches so v goes well past 1,
+ * we store v divided by PACKED_TEXCOORD_RANGE and our shaders scale
+ * it back up.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef packedverticesh
+#define packedverticesh
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "vec2.h"
+#include "vec3.h"
+
+#define		PACKED_TEXCOORD_RANGE		64.0f					// v is stored divided by this, larger values are clamped
+
+// the layouts our vertices can be uploaded in
+enum vertexFormats {
+	vertex_planar,												// separate arrays of vec3 positions, vec3 normals and vec2 texture coordinates
+	vertex_packed_float,										// interleaved float position, octahedral normal and unorm16 texture coordinates, 20 bytes
+	vertex_packed_half											// same but with a half float position, 16 bytes
+};
+
+class packedvertices {
+private:
+	vertexFormats				mFormat;						// our layout
+	unsigned long				mStride;						// size of a single vertex in bytes
+	unsigned long				mCount;							// number of vertices
+	std::vector<unsigned char>	mData;							// our vertices
+
+public:
+	packedvertices();
+
+	// properties
+	vertexFormats format() const;
+	void setFormat(vertexFormats pFormat);
+	unsigned long stride() const;
+	unsigned long normalOffset() const;
+	unsigned long texCoordOffset() const;
+	unsigned long size() const;
+	const unsigned char* data() const;
+	unsigned long memoryUsed() const;
+
+	// interface
+	void clear();
+	void resize(unsigned long pCount);
+	void set(unsigned long pIndex, const vec3& pPosition, const vec3& pNormal, const vec2& pTexCoord);
+	void reorder(const std::vector<unsigned long>& pNewIndex);
+
+	// helpers
+	static unsigned short toHalf(float pValue);
+	static void encodeNormal(const vec3& pNormal, short* pEncoded);
+	static vec3 decodeNormal(const short* pEncoded);
+	static unsigned short toUnorm16(float pValue);
+};
+
+#endif
@@ -0,0 +1,57 @@
+/********************************************************************
+ * pointcloud stores our attraction points as separate arrays
+ *
+ * Keeping our x, y and z coordinates in separate arrays allows us to
+ * test 8 attraction points against a vertex at once using AVX2 (or 4
+ * using SSE4.1). Which kernel we use is decided at runtime so we still
+ * run on CPUs without these instruction sets.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef pointcloudh
+#define pointcloudh
+
+#include <math.h>
+#include <pthread.h>
+#include <vector>
+
+#include "vec3.h"
+#include "attractionpoint.h"
+
+// which kernel findClosest uses
+enum pointKernels {
+	kernel_scalar,												// plain C++
+	kernel_sse4,												// 4 points at a time
+	kernel_avx2													// 8 points at a time
+};
+
+class pointcloud {
+private:
+	void findClosestScalar(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo);
+	void findClosestSSE4(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo);
+	void findClosestAVX2(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo);
+
+public:
+	std::vector<float>			x;							// x coordinates of our attraction points
+	std::vector<float>			y;							// y coordinates of our attraction points
+	std::vector<float>			z;							// z coordinates of our attraction points
+	std::vector<unsigned long>	closest;					// closest vertice for each attraction point
+	std::vector<float>			distance;					// distance to our closest vertice
+
+	// properties
+	unsigned long size() const;
+	unsigned long memoryUsed() const;
+
+	// interface
+	void clear();
+	void load(const std::vector<attractionPoint>& pPoints);
+	void compact(const std::vector<unsigned char>& pRemove);
+	void findClosest(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo);
+
+	// helpers
+	static pointKernels kernel();
+	static void setKernel(pointKernels pKernel);
+};
+
+#endif
@@ -0,0 +1,42 @@
+/********************************************************************
+ * pointgrid is a uniform hash grid over our attraction points
+ *
+ * It allows us to find the attraction points that are near to a
+ * vertex without testing every attraction point we have.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef pointgridh
+#define pointgridh
+
+#include <math.h>
+#include <vector>
+
+#include "vec3.h"
+#include "attractionpoint.h"
+
+class pointgrid {
+private:
+	float						mCellSize;					// size of each cell in our grid
+	unsigned long				mMask;						// our table size is a power of 2, this is our table size - 1
+	std::vector<unsigned long>	mStart;						// start of each bucket within mIndices (table size + 1 entries)
+	std::vector<unsigned long>	mIndices;					// indices of our attraction points sorted by bucket
+
+	long cell(float pValue) const;
+	unsigned long bucket(long pX, long pY, long pZ) const;
+
+public:
+	pointgrid();
+
+	// properties
+	float cellSize();
+	unsigned long memoryUsed() const;
+
+	// interface
+	void clear();
+	void build(const std::vector<attractionPoint>& pPoints, float pCellSize);
+	void findNear(const vec3& pPosition, std::vector<unsigned long>& pFound) const;
+};
+
+#endif
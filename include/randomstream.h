@@ -0,0 +1,45 @@
+/********************************************************************
+ * randomstream is a seedable counter based random number generator
+ *
+ * Each number is a hash of our seed, our stream number and a counter
+ * so streams are independent of each other, two trees with the same
+ * seed get the same numbers and we can jump to any position in a
+ * stream without generating the numbers before it.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef randomstreamh
+#define randomstreamh
+
+// the streams our treebuilder uses for each stage that needs random numbers
+enum randomStreams {
+	stream_attraction_points,									// positions of our attraction points
+	stream_leaves												// sizes of our leaves
+};
+
+class randomstream {
+private:
+	unsigned long long	mKey;									// hash of our seed and stream number
+	unsigned long long	mCounter;								// position of our next number
+
+public:
+	randomstream();
+	randomstream(unsigned long long pSeed, unsigned long long pStream);
+	
+	// properties
+	unsigned long long counter() const;
+	void setCounter(unsigned long long pCounter);
+	
+	// interface
+	void reset(unsigned long long pSeed, unsigned long long pStream);
+	unsigned long long at(unsigned long long pCounter) const;
+	unsigned long long next();
+	float randf(float pMin = -1.0f, float pMax = 1.0f);
+	
+	// helpers
+	static unsigned long long mix(unsigned long long pValue);
+	static float toFloat(unsigned long long pValue, float pMin, float pMax);
+};
+
+#endif
@@ -0,0 +1,66 @@
+/********************************************************************
+ * threadpool runs batches of jobs on a set of worker threads
+ *
+ * Each worker starts off with its own share of the jobs in a batch,
+ * a worker that runs out steals half of the remaining jobs of another
+ * worker so we keep all our cores busy even if some jobs take much
+ * longer than others.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef threadpoolh
+#define threadpoolh
+
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+class threadpool {
+public:
+	// a job function is called with our data, the number of the job to run and the number of the worker running it
+	typedef void (*jobFunction)(void* pData, unsigned long pJob, int pWorker);
+
+private:
+	// the jobs a worker still needs to run
+	class jobQueue {
+	public:
+		pthread_mutex_t			mutex;							// protects next and end
+		unsigned long			next;							// next job we'll run ourselves
+		unsigned long			end;							// job after our last job, others steal from this end
+	};
+
+	std::vector<pthread_t>	mThreads;						// our worker threads (we use numThreads - 1 threads, the caller is our last worker)
+	std::vector<jobQueue*>	mQueues;						// jobs for each worker
+	pthread_mutex_t			mMutex;							// protects the members below
+	pthread_cond_t			mStartCond;						// signalled when a new batch is available or we're stopping
+	pthread_cond_t			mDoneCond;						// signalled when the last job of a batch has finished or a worker goes idle
+
+	jobFunction				mFunction;						// function for our current batch
+	void*					mData;							// data for our current batch
+	unsigned long			mNumJobs;						// number of jobs in our current batch
+	unsigned long			mJobsDone;						// number of jobs finished, updated atomically
+	unsigned long			mBatch;							// incremented for every batch so workers can tell a new batch has started
+	int						mActive;						// number of worker threads still looking for jobs in our current batch
+	bool					mStopping;						// true if our workers need to exit
+
+	static void* workerMain(void* pParam);
+	bool popJob(int pWorker, unsigned long& pJob);
+	bool stealJob(int pWorker, unsigned long& pJob);
+	void runJobs(int pWorker);
+
+public:
+	threadpool(int pNumThreads = 0);
+	~threadpool();
+
+	// properties
+	int numThreads();
+
+	// interface
+	void run(jobFunction pFunction, void* pData, unsigned long pNumJobs);
+
+	// helpers
+	static int numCores();
+};
+
+#endif
@@ -0,0 +1,19 @@
+/********************************************************************
+ * Our headless batch generator
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <string>
+
+#include "forest.h"
+#include "meshexport.h"
+#include "meshfile.h"
+#include "treebuilder.h"
+#include "treecache.h"
+#include "treemesh.h"
@@ -0,0 +1,20 @@
+/********************************************************************
+ * Our benchmark suite
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "forest.h"
+#include "mat3.h"
+#include "mat4.h"
+#include "pointcloud.h"
+#include "treebuilder.h"
+#include "treestats.h"
+#include "vec3.h"
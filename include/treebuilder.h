@@ -0,0 +1,257 @@
+/********************************************************************
+ * treebuilder contains the logic to generate our tree
+ * 
+ * Implementation based on the "Space Colonization Algorithm" by
+ * Adam Runions, Brendan Lane, and Przemyslaw Prusinkiewicz
+ *
+ * treebuilder doesn't depend on OpenGL so we can also use it to
+ * generate trees from the command line, see treelogic for rendering.
+ * 
+ * By Bastiaan Olij - 2014
+********************************************************************/
+
+#ifndef treebuilderh
+#define treebuilderh
+
+// standard libraries we need...
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <time.h> 
+#include <vector>
+
+#include "vec2.h"
+#include "vec3.h"
+#include "mat3.h"
+
+#include "attractionpoint.h"
+#include "indexbuffer.h"
+#include "meshoptimiser.h"
+#include "packedvertices.h"
+#include "pointcloud.h"
+#include "pointgrid.h"
+#include "randomstream.h"
+#include "threadpool.h"
+#include "treemesh.h"
+#include "treenode.h"
+#include "treestats.h"
+#include "treetrace.h"
+#include "vertextree.h"
+
+// how doIteration finds the closest vertice for each attraction point
+enum searchModes {
+	search_brute_force,											// test every attraction point against every new vertex
+	search_grid,												// use a uniform grid so new vertices only test nearby attraction points
+	search_kdtree,												// use a k-d tree over our vertices to find the closest vertice for each attraction point
+	search_simd													// brute force on a copy of our attraction points stored as separate arrays using SSE4/AVX2
+};
+
+// class for a slice
+class slice {
+public:
+	unsigned long p[5];											// 5 vertices to a slice
+	
+	slice();
+	slice(const slice& pCopy);
+
+	slice& operator=(const slice& pCopy);
+};
+
+// Our treebuilder class, note that after we are finished only mVertices, mNormals, mTexCoords and our elements are relevant
+class treebuilder {
+protected:
+	std::vector<attractionPoint>		mAttractionPoints;		// our attraction points
+	std::vector<vec3>					mVertices;				// vertices that make up our tree
+	std::vector<vec3>					mNormals;				// normals for our vertice
+	std::vector<vec2>					mTexCoords;				// texture coordinates
+	std::vector<treenode>				mNodes;					// nodes used to construct our tree skeleton
+	std::vector<long>					mVertexNodes;			// for each vertex the node ending in it (-1 if none)
+	std::vector<unsigned long>			mChildStart;			// children of node n are mChildNodes[mChildStart[n+1]] up to mChildNodes[mChildStart[n+2]], our root nodes come first
+	std::vector<unsigned long>			mChildNodes;			// child node indices, see buildChildIndex()
+	std::vector<slice>					mSlices;				// slices that form the basis of
+	std::vector<quad>					mTreeElements;			// our tree elements
+	std::vector<triangle>				mLeafElements;			// our leaf elements
+	packedvertices						mPackedVertices;		// our mesh vertices in a packed layout, only if our vertex format isn't vertex_planar
+	indexbuffer							mTreeIndices;			// our tree elements as 16 bit indices, only if mShortIndices is set and they fit
+	indexbuffer							mLeafIndices;			// our leaf elements as 16 bit indices, only if mShortIndices is set and they fit
+	std::vector<vec3>					mSkeletonVertices;		// vertices of our skeleton, kept by createModel
+	std::vector<treenode>				mSkeletonNodes;			// nodes of our skeleton, kept by createModel
+	
+	bool								mUpdateBuffers;			// set whenever our vertices or elements change so our buffers get updated
+	
+	float								mMinRadius;				// Minimum radius for our tree
+	float								mRadiusFactor;			// Factor to apply to calculate the radius of our tree
+	vec2								mLeafSize;				// Size of our leaf
+	
+	treestats							mStats;					// timings and counters, only recorded when built with TREES_STATS
+
+private:
+	unsigned long long					mSeed;					// seed for our random numbers
+	randomstream						mPointsRandom;			// random numbers for our attraction points
+	randomstream						mLeavesRandom;			// random numbers for our leaves
+	
+	unsigned long						mLastNumOfVerts;		// number of vertices before we added our last round of nodes
+	unsigned long						mPeakMemory;			// highest memoryUsed() we've seen, see updatePeakMemory()
+	bool								mLazyChildCount;		// if true growBranch doesn't update childcount, we recount all nodes when we need them
+	bool								mChildCountDirty;		// true if our childcounts need to be recounted
+	bool								mBatchOptimise;			// if true optimiseNodes marks all merges first and removes nodes and vertices in one pass
+	bool								mOptimiseVertexCache;	// if true createModel reorders our mesh for the vertex cache
+	bool								mShortIndices;			// if true createModel also writes our elements as 16 bit indices
+	cachestats							mCacheStats;			// vertex cache efficiency of our last model
+	
+	searchModes							mSearchMode;			// how we find the closest vertice for our attraction points
+	float								mSearchRadius;			// closest vertices are exact within this radius (FLT_MAX if fully exact)
+	pointgrid							mPointGrid;				// grid over our attraction points used by search_grid
+	vertextree							mVertexTree;			// k-d tree over our vertices used by search_kdtree
+	pointcloud							mPointCloud;			// copy of our attraction points as separate arrays used by search_simd
+	bool								mPointCloudLoaded;		// true if mPointCloud matches mAttractionPoints
+	
+	bool								mParallel;				// if true doIteration and createModel run on our thread pool
+	int									mNumThreads;			// number of threads in our thread pool (0 = one per core)
+	threadpool*							mThreadPool;			// our thread pool, created when we first need it
+	
+	// buffers each worker accumulates into when doIteration runs in parallel, we keep these between iterations
+	// and only clear the slots of the vertices we've touched
+	class iterationBuffers {
+	public:
+		std::vector<unsigned long>		numOfAPoints;			// number of attraction points for each vertice
+		std::vector<long long>			directions;				// sum of the directions to those points in fixed point, 3 per vertice
+		std::vector<unsigned long>		lastClosest;			// highest index of those points for each vertice
+		std::vector<unsigned long>		touched;				// vertices we've counted points towards this iteration
+		std::vector<long>				stack;					// scratch buffer for our k-d tree searches
+	};
+	
+	// everything our workers need for one parallel iteration
+	class iterationJob {
+	public:
+		treebuilder*					tree;
+		float							maxDistance;
+		float							cutOffDistance;
+		float							searchRadius;
+		bool							catchUp;
+		std::vector<float>*				distances;
+		std::vector<unsigned char>*		reached;				// one byte per point so our workers never write to the same word
+		std::vector<iterationBuffers>*	buffers;
+	};
+	
+	std::vector<iterationBuffers>		mIterationBuffers;		// one for each of our workers, see countPointsInParallel
+	
+	// where expandChildren writes its next vertex and elements, also used for the number of each a subtree writes
+	class meshCursor {
+	public:
+		unsigned long					vertex;					// index in mVertices, mNormals and mTexCoords
+		unsigned long					quad;					// index in mTreeElements
+		unsigned long					triangle;				// index in mLeafElements
+	};
+	
+	// a node on the stack expandChildren uses to walk our tree
+	class expandFrame {
+	public:
+		long							node;					// node we're expanding the children of (-1 for our root nodes)
+		slice							parentSlice;			// slice we created for our node
+		vec3							offset;					// vector by which to offset what we're creating
+		float							distance;				// distance travelled along our tree
+		bool							started;				// true once we've created our slices for a node with multiple children
+		unsigned long					nextChild;				// next child we'll expand
+		unsigned long					firstSlice;				// index of our first slice on our slice stack
+		vec3							bitangent;				// bitangent for the slices of our children
+	};
+	
+	// a subtree expandChildren left for our workers
+	class subtreeJob {
+	public:
+		expandFrame						frame;					// frame of the node at the top of our subtree
+		meshCursor						cursor;					// where our subtree starts writing
+	};
+	
+	// everything our workers need to expand our subtrees
+	class modelJob {
+	public:
+		treebuilder*					tree;
+		std::vector<subtreeJob>*		subtrees;
+	};
+	
+	std::vector<meshCursor>				mSubtreeCounts;			// number of vertices and elements expandChildren writes for node n in slot n+1, all our root nodes in slot 0
+	
+	unsigned long addVertex(const vec3& pVertex);
+	void remVertex(unsigned long pIndex);
+	void remVertices(const std::vector<bool>& pRemove);
+	void updatePeakMemory(unsigned long pTemporary);
+	void updateChildCounts();
+	void buildChildIndex();
+	void optimiseNodesBatched();
+	
+	void findClosestBruteForce(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, bool pCatchUp);
+	void findClosestUsingGrid(std::vector<float>& pDistances, float pRadius, bool pCatchUp);
+	void findClosestUsingTree(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, float pRadius, bool pCatchUp, std::vector<long>& pStack);
+	void findClosestUsingSimd(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, bool pCatchUp);
+	static void runIterationJob(void* pData, unsigned long pJob, int pWorker);
+	void countPointsInParallel(std::vector<float>& pDistances, float pMaxDistance, float pCutOffDistance, float pSearchRadius, bool pCatchUp, std::vector<float>& pNumOfAPoints, std::vector<vec3>& pDirections, std::vector<unsigned long>& pLastClosest, std::vector<unsigned char>& pReached);
+	
+	unsigned long writeVertex(meshCursor& pCursor, const vec3& pVertex, const vec3& pNormal, const vec2& pTexCoord);
+	slice createSlice(meshCursor& pCursor, vec3 pCenter, vec3 pPlaneNormal, vec3 pBitangent, float pSize, float pDistance);
+	void capSlice(meshCursor& pCursor, const slice& pSlice);
+	void joinTwoSlices(meshCursor& pCursor, const slice& pA, const slice& pB);
+	void joinMultiSlices(meshCursor& pCursor, long pSliceCount, slice* pSlices);
+	void addLeaves(meshCursor& pCursor, vec3 pCenter, vec3 pTangent, vec3 pBiTangent);
+	void countSubtrees();
+	void expandChildren(const expandFrame& pFrame, meshCursor& pCursor, std::vector<subtreeJob>* pJobs, unsigned long pJobSize);
+	static void runModelJob(void* pData, unsigned long pJob, int pWorker);
+	void reorderForVertexCache();
+
+public:	
+	// constructors/destructors
+	treebuilder();
+	virtual ~treebuilder();
+	
+	// properties
+	unsigned long long seed();
+	void setSeed(unsigned long long pSeed);
+	float minRadius();
+	void setMinRadius(float pRadius);
+	float radiusFactor();
+	void setRadiusFactor(float pFactor);
+	vec2 leafSize();
+	void setLeafSize(vec2 pSize);
+	searchModes searchMode();
+	void setSearchMode(searchModes pMode);
+	bool parallel();
+	void setParallel(bool pParallel);
+	int numThreads();
+	void setNumThreads(int pNumThreads);
+	bool lazyChildCount();
+	void setLazyChildCount(bool pLazy);
+	bool batchOptimise();
+	void setBatchOptimise(bool pBatch);
+	vertexFormats vertexFormat();
+	void setVertexFormat(vertexFormats pFormat);
+	bool optimiseVertexCache();
+	void setOptimiseVertexCache(bool pOptimise);
+	bool shortIndices();
+	void setShortIndices(bool pShort);
+	
+	// our tree
+	const std::vector<vec3>& vertices() const;
+	const std::vector<vec3>& normals() const;
+	const std::vector<vec2>& texCoords() const;
+	const std::vector<quad>& treeElements() const;
+	const std::vector<triangle>& leafElements() const;
+	const packedvertices& packedVertices() const;
+	const indexbuffer& treeIndices() const;
+	const indexbuffer& leafIndices() const;
+	unsigned long numOfNodes() const;
+	unsigned long memoryUsed() const;
+	unsigned long peakMemory() const;
+	const treestats& stats() const;
+	const cachestats& cacheStats() const;
+	
+	// tree generation code
+	unsigned long growBranch(unsigned long pFromVertex, vec3 pTo);
+	void generateAttractionPoints(unsigned long pNumOfPoints = 5000, float pOuterRadius = 100.0f, float pInnerRadius = 50.0f, float pAspect = 3.0f, float pOffsetY = 20.0f, bool pClear = true);
+	bool doIteration(float pMaxDistance = 75.0f, float pBranchSize = 5.0f, float pCutOffDistance = 10.0f, vec3 pBias = vec3(0.0, 0.0, 0.0));
+	void optimiseNodes();
+	void createModel();
+	void takeMesh(treemesh& pMesh);
+};
+
+#endif
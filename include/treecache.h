@@ -0,0 +1,61 @@
+/********************************************************************
+ * treecache keeps generated trees on disk
+ *
+ * Trees are stored in a file named after a hash of everything that
+ * determines how the tree turns out, so asking for the same tree
+ * twice only generates it once. We delete the trees used least
+ * recently when our cache grows beyond its maximum size.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef treecacheh
+#define treecacheh
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "forest.h"
+#include "meshfile.h"
+#include "treemesh.h"
+
+// bump this whenever a change to treebuilder changes the trees it generates so old entries are ignored
+#define		TREECACHE_GENERATOR		4
+
+class treecache {
+private:
+	std::string				mDirectory;						// directory our trees are stored in
+	unsigned long long		mMaxSize;						// maximum size of our cache in bytes (0 = unlimited)
+	pthread_mutex_t			mMutex;							// protects our counters and eviction
+	unsigned long			mHits;							// number of trees we found in our cache
+	unsigned long			mMisses;						// number of trees we had to generate
+	
+	std::string fileName(const std::vector<unsigned char>& pKey) const;
+	bool openFile(const std::string& pFileName, const std::vector<unsigned char>& pKey, meshfile& pFile) const;
+	bool writeFile(const std::string& pFileName, const std::vector<unsigned char>& pKey, const treemesh& pMesh) const;
+
+public:
+	treecache(const std::string& pDirectory, unsigned long long pMaxSize = 0);
+	~treecache();
+	
+	// properties
+	const std::string& directory() const;
+	unsigned long long maxSize() const;
+	void setMaxSize(unsigned long long pMaxSize);
+	unsigned long hits();
+	unsigned long misses();
+	
+	// interface
+	bool open(const treespec& pSpec, meshfile& pFile, bool pParallel = false);
+	bool load(const treespec& pSpec, treemesh& pMesh, bool pParallel = false);
+	bool store(const treespec& pSpec, const treemesh& pMesh, bool pParallel = false);
+	void getTree(const treespec& pSpec, treemesh& pMesh);
+	void evict();
+	
+	// helpers
+	static void makeKey(const treespec& pSpec, bool pParallel, std::vector<unsigned char>& pKey);
+	static unsigned long long hash(const std::vector<unsigned char>& pKey);
+};
+
+#endif
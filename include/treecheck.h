@@ -0,0 +1,21 @@
+/********************************************************************
+ * Our checks
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "forest.h"
+#include "meshfile.h"
+#include "treebuilder.h"
+#include "treecache.h"
+#include "treemesh.h"
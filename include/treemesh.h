@@ -0,0 +1,57 @@
+/********************************************************************
+ * treemesh holds the mesh of a finished tree
+ *
+ * Our bark is made up of quads which we render as patches, our leaves
+ * are triangles. Both index into the same vertex arrays. We also keep
+ * the skeleton our mesh was built from which has its own vertices.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef treemeshh
+#define treemeshh
+
+#include <vector>
+
+#include "vec2.h"
+#include "vec3.h"
+#include "treenode.h"
+
+// class for a triangle
+class triangle {
+public:
+	unsigned int v[3];											// index to our vertex buffer (same layout as a GLuint)
+	
+	triangle();
+	triangle(const triangle& pCopy);
+	
+	triangle& operator=(const triangle& pCopy);
+};
+
+// class for a quad
+class quad {
+public:
+	unsigned int v[4];											// index to our vertex buffer (same layout as a GLuint)
+	
+	quad();
+	quad(const quad& pCopy);
+	
+	quad& operator=(const quad& pCopy); 
+};
+
+// class for the mesh of a tree
+class treemesh {
+public:
+	std::vector<vec3>			vertices;						// vertices of our mesh
+	std::vector<vec3>			normals;						// normal for each vertex
+	std::vector<vec2>			texCoords;						// texture coordinate for each vertex
+	std::vector<quad>			treeElements;					// quads making up our bark
+	std::vector<triangle>		leafElements;					// triangles making up our leaves
+	std::vector<vec3>			skeletonVertices;				// vertices of our skeleton
+	std::vector<treenode>		skeletonNodes;					// nodes of our skeleton, these index into skeletonVertices
+	
+	void clear();
+	void swap(treemesh& pMesh);
+};
+
+#endif
@@ -0,0 +1,108 @@
+/********************************************************************
+ * treestats keeps timings and counters of our tree generation
+ *
+ * Our code records its stats through the TREES_STATS_ macros below
+ * which compile to nothing unless TREES_STATS is defined, so normal
+ * builds pay nothing for them. Build with "make batch STATS=1" to
+ * enable them. treestats itself always exists so code querying it
+ * doesn't need to check, without TREES_STATS everything stays 0.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef treestatsh
+#define treestatsh
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+
+// stages we time
+enum statsStages {
+	stage_iteration,											// doIteration
+	stage_optimise,												// optimiseNodes
+	stage_model,												// createModel
+	stage_vertex_cache,											// reordering our mesh for the vertex cache, part of createModel
+	stage_render,												// treelogic::render
+	num_of_stages
+};
+
+// things we count
+enum statsCounters {
+	counter_points_examined,									// attraction points we looked for a closest vertice for
+	counter_points_killed,										// attraction points removed because a vertice reached them
+	counter_branches_grown,										// branches added by doIteration
+	counter_distance_evaluations,								// distances calculated between an attraction point and a vertice
+	num_of_counters
+};
+
+// what happened in a single call to doIteration
+class iterationstats {
+public:
+	unsigned long long	counters[num_of_counters];				// our counters for just this iteration
+	double				wallTime;								// time our iteration took in milliseconds
+};
+
+class treestats {
+private:
+	unsigned long long			mCounters[num_of_counters];		// our counters, added to atomically
+	double						mStageTime[num_of_stages];		// total time spent in each stage in milliseconds
+	unsigned long				mStageCalls[num_of_stages];		// number of times each stage ran
+	std::vector<iterationstats>	mIterations;					// our iterations
+	unsigned long long			mIterationStart[num_of_counters];	// our counters when our current iteration started
+	double						mIterationStartTime;			// time our current iteration started
+
+public:
+	treestats();
+
+	// properties
+	unsigned long long counter(statsCounters pCounter) const;
+	double stageTime(statsStages pStage) const;
+	unsigned long stageCalls(statsStages pStage) const;
+	unsigned long numOfIterations() const;
+	const iterationstats& iteration(unsigned long pIteration) const;
+
+	// interface
+	void reset();
+	void add(statsCounters pCounter, unsigned long long pValue);
+	void addTime(statsStages pStage, double pTime);
+	void beginIteration();
+	void endIteration();
+	void toJSON(std::string& pJSON) const;
+	bool writeJSON(const std::string& pFileName) const;
+
+	// helpers
+	static bool enabled();
+	static double now();
+	static unsigned long peakProcessMemory();
+	static const char* stageName(statsStages pStage);
+	static const char* counterName(statsCounters pCounter);
+};
+
+// times the rest of the scope it is declared in
+class statstimer {
+private:
+	treestats&		mStats;
+	statsStages		mStage;
+	double			mStart;
+
+public:
+	statstimer(treestats& pStats, statsStages pStage);
+	~statstimer();
+};
+
+#ifdef TREES_STATS
+#define		TREES_STATS_TIMER(pStats, pStage)			statstimer statsTimer(pStats, pStage)
+#define		TREES_STATS_ADD(pStats, pCounter, pValue)	(pStats).add(pCounter, pValue)
+#define		TREES_STATS_BEGIN_ITERATION(pStats)			(pStats).beginIteration()
+#define		TREES_STATS_END_ITERATION(pStats)			(pStats).endIteration()
+#else
+#define		TREES_STATS_TIMER(pStats, pStage)
+#define		TREES_STATS_ADD(pStats, pCounter, pValue)
+#define		TREES_STATS_BEGIN_ITERATION(pStats)
+#define		TREES_STATS_END_ITERATION(pStats)
+#endif
+
+#endif
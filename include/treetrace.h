@@ -0,0 +1,81 @@
+/********************************************************************
+ * treetrace records a timeline of our tree generation
+ *
+ * Our code marks the start and end of the work it does through the
+ * TREES_TRACE_ macros below, these compile to nothing unless
+ * TREES_TRACE is defined. Build with "make batch TRACE=1" to enable
+ * them. Each thread records its events into its own ring buffer so
+ * recording never takes a lock, once we're done we write all buffers
+ * out in the trace event format that chrome://tracing and Perfetto
+ * can open. When a ring buffer fills up its oldest events are lost.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef treetraceh
+#define treetraceh
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#define		TREETRACE_BUFFER_SIZE		65536					// number of events each thread keeps, must be a power of 2
+
+// a single event in our timeline
+class traceevent {
+public:
+	const char*			name;									// name of our event, must be a string literal
+	char				phase;									// 'B' for begin, 'E' for end, 'i' for an instant
+	unsigned long long	timestamp;								// microseconds since our trace started
+};
+
+// the events recorded by one thread, only that thread writes to it
+class tracebuffer {
+public:
+	unsigned long		thread;									// number we gave our thread
+	unsigned long		count;									// number of events written so far, may be more than our size
+	traceevent			events[TREETRACE_BUFFER_SIZE];			// our ring buffer
+};
+
+class treetrace {
+private:
+	static tracebuffer* threadBuffer();
+	static void record(const char* pName, char pPhase);
+
+public:
+	// interface
+	static void begin(const char* pName);
+	static void end(const char* pName);
+	static void instant(const char* pName);
+	static bool write(const std::string& pFileName);
+	static void clear();
+
+	// helpers
+	static bool enabled();
+	static unsigned long long now();
+};
+
+// traces the rest of the scope it is declared in
+class tracescope {
+private:
+	const char*		mName;
+
+public:
+	tracescope(const char* pName);
+	~tracescope();
+};
+
+#ifdef TREES_TRACE
+#define		TREES_TRACE_SCOPE(pName)				tracescope traceScope(pName)
+#define		TREES_TRACE_BEGIN(pName)				treetrace::begin(pName)
+#define		TREES_TRACE_END(pName)					treetrace::end(pName)
+#define		TREES_TRACE_INSTANT(pName)				treetrace::instant(pName)
+#else
+#define		TREES_TRACE_SCOPE(pName)
+#define		TREES_TRACE_BEGIN(pName)
+#define		TREES_TRACE_END(pName)
+#define		TREES_TRACE_INSTANT(pName)
+#endif
+
+#endif
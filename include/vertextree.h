@@ -0,0 +1,62 @@
+/********************************************************************
+ * vertextree is a k-d tree over the vertices of our tree skeleton
+ *
+ * Vertices are inserted incrementally as our tree grows. As we mostly
+ * insert along branches our k-d tree tends to form long chains so we
+ * rebuild a balanced tree whenever it becomes too deep.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#ifndef vertextreeh
+#define vertextreeh
+
+#include <math.h>
+#include <vector>
+
+#include "vec3.h"
+
+class vertextree {
+private:
+	class kdnode {
+	public:
+		vec3			position;								// copy of our vertex position
+		unsigned long	vertex;									// index of our vertex
+		unsigned long	maxVertex;								// highest vertex index in our subtree
+		long			left;									// node with positions below ours on our axis (-1 if none)
+		long			right;									// node with positions above ours on our axis (-1 if none)
+		int				axis;									// axis we split on (0 = x, 1 = y, 2 = z)
+	};
+
+	// sort helper used while building our balanced tree
+	class kdnodeless {
+	public:
+		int				axis;
+
+		kdnodeless(int pAxis);
+		bool operator()(const kdnode& pA, const kdnode& pB) const;
+	};
+
+	std::vector<kdnode>		mNodes;							// our nodes
+	long					mRoot;							// index of our root node (-1 if we're empty)
+	unsigned long			mBalancedCount;					// number of nodes when we last rebuilt our tree
+	unsigned long			mMaxDepth;						// deepest node we've inserted since we last rebuilt our tree
+
+	static float coord(const vec3& pVector, int pAxis);
+	long buildBalanced(unsigned long pFrom, unsigned long pTo, int pAxis);
+	void insert(const vec3& pPosition, unsigned long pVertex);
+
+public:
+	vertextree();
+
+	// properties
+	unsigned long size() const;
+	unsigned long memoryUsed() const;
+
+	// interface
+	void clear();
+	void update(const std::vector<vec3>& pVertices);
+	unsigned long findClosest(const vec3& pPosition, unsigned long pFirstVertex, unsigned long& pClosest, float& pDistance, float pRadius, std::vector<long>& pStack) const;
+};
+
+#endif
@@ -11,6 +11,7 @@ attractionPoint::attractionPoint() {
 	position.y = 0;
 	position.z = 0;
 	closestVertice = 0;
+	firstVertice = 0;
 };
 
 attractionPoint::attractionPoint(float pX, float pY, float pZ) {
@@ -18,20 +19,24 @@ attractionPoint::attractionPoint(float pX, float pY, float pZ) {
 	position.y = pY;
 	position.z = pZ;
 	closestVertice = 0;
+	firstVertice = 0;
 };
 
 attractionPoint::attractionPoint(vec3 pPosition) {
 	position = pPosition;
 	closestVertice = 0;
+	firstVertice = 0;
 };
 
 attractionPoint::attractionPoint(const attractionPoint& pCopy) {
 	position = pCopy.position;
 	closestVertice = pCopy.closestVertice;
+	firstVertice = pCopy.firstVertice;
 };
 
 attractionPoint& attractionPoint::operator=(const attractionPoint& pCopy) {
 	position = pCopy.position;
 	closestVertice = pCopy.closestVertice;
+	firstVertice = pCopy.firstVertice;
 	return (*this);
 };
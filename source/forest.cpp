@@ -0,0 +1,256 @@
+/********************************************************************
+ * forest generates a whole set of trees in parallel
+ *
+ * Each tree is described by a treespec, the trees are built as
+ * separate jobs on our thread pool so a forest of N trees keeps N
+ * cores busy. Meshes are handed to a callback as each tree finishes.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "forest.h"
+#include "treecache.h"
+
+/////////////////////////////////////////////////////////////////////
+// specs
+/////////////////////////////////////////////////////////////////////
+
+cloudspec::cloudspec() {
+	numOfPoints = 800;
+	outerRadius = 75.0f;
+	innerRadius = 50.0f;
+	aspect = 1.5f;
+	offsetY = 50.0f;
+};
+
+cloudspec::cloudspec(unsigned long pNumOfPoints, float pOuterRadius, float pInnerRadius, float pAspect, float pOffsetY) {
+	numOfPoints = pNumOfPoints;
+	outerRadius = pOuterRadius;
+	innerRadius = pInnerRadius;
+	aspect = pAspect;
+	offsetY = pOffsetY;
+};
+
+growspec::growspec() {
+	maxDistance = 100.0f;
+	branchSize = 1.0f;
+	cutOffDistance = 10.0f;
+	bias = vec3(0.0f, 0.0f, 0.0f);
+};
+
+growspec::growspec(float pMaxDistance, float pBranchSize, float pCutOffDistance, vec3 pBias) {
+	maxDistance = pMaxDistance;
+	branchSize = pBranchSize;
+	cutOffDistance = pCutOffDistance;
+	bias = pBias;
+};
+
+treespec::treespec() {
+	seed = 0;
+	trunk = vec3(0.0f, 10.0f, 0.0f);
+	
+	// as a sample we've staged our points to get larger concentrations of points nearer to the center
+	clouds.push_back(cloudspec(800, 75.0f, 50.0f, 1.5f, 50.0f));
+	clouds.push_back(cloudspec(300, 90.0f, 75.0f, 1.5f, 60.0f));
+	clouds.push_back(cloudspec(50, 100.0f, 90.0f, 1.5f, 70.0f));
+	
+	// grow our tree and then our roots
+	stages.push_back(growspec(100.0f, 1.0f, 10.0f, vec3(0.1f, 0.2f, 0.0f)));
+	stages.push_back(growspec(30.0f, 2.0f, 10.0f, vec3(0.0f, 0.0f, 0.0f)));
+	
+	optimise = true;
+	minRadius = 0.4f;
+	radiusFactor = 0.0005f;
+	leafSize = vec2(20.0f, 30.0f);
+	searchMode = search_simd;
+	optimiseVertexCache = true;
+};
+
+buildreport::buildreport() {
+	pointsTime = 0.0;
+	growTime = 0.0;
+	optimiseTime = 0.0;
+	modelTime = 0.0;
+	iterations = 0;
+	grownNodes = 0;
+	numOfNodes = 0;
+	peakMemory = 0;
+};
+
+/////////////////////////////////////////////////////////////////////
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * forest(pNumThreads)
+ *
+ * Creates our forest, if pNumThreads is 0 we use one thread per core
+ **/
+forest::forest(int pNumThreads) {
+	mNumThreads = pNumThreads;
+	mThreadPool = NULL;
+	mCache = NULL;
+	pthread_mutex_init(&mCallbackMutex, NULL);
+};
+
+forest::~forest() {
+	// stop our worker threads
+	if (mThreadPool != NULL) {
+		delete mThreadPool;
+		mThreadPool = NULL;
+	};
+	
+	pthread_mutex_destroy(&mCallbackMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+int forest::numThreads() {
+	return mNumThreads;
+};
+
+void forest::setNumThreads(int pNumThreads) {
+	if (mNumThreads != pNumThreads) {
+		mNumThreads = pNumThreads;
+		
+		// we'll create a new pool with the right number of threads when we need it
+		if (mThreadPool != NULL) {
+			delete mThreadPool;
+			mThreadPool = NULL;
+		};
+	};
+};
+
+treecache* forest::cache() {
+	return mCache;
+};
+
+/**
+ * setCache(pCache)
+ *
+ * Sets a cache to get our trees from, trees we don't find are generated and added to it. We don't own our cache.
+ **/
+void forest::setCache(treecache* pCache) {
+	mCache = pCache;
+};
+
+/////////////////////////////////////////////////////////////////////
+// workers
+/////////////////////////////////////////////////////////////////////
+
+void forest::runTreeJob(void* pData, unsigned long pJob, int) {
+	forestJob* job = (forestJob*) pData;
+	treemesh mesh;
+	
+	if (job->owner->mCache != NULL) {
+		job->owner->mCache->getTree((*job->specs)[pJob], mesh);
+	} else {
+		buildTree((*job->specs)[pJob], mesh);
+	};
+	
+	pthread_mutex_lock(&job->owner->mCallbackMutex);
+	job->callback(job->data, pJob, mesh);
+	pthread_mutex_unlock(&job->owner->mCallbackMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * generate(pSpecs, pCallback, pData)
+ *
+ * Generates a tree for each spec in pSpecs and returns once all are finished. Our trees are built in parallel,
+ * as soon as a tree is finished its mesh is handed to pCallback. Trees finish in any order, pTree tells you
+ * which spec a mesh belongs to. The callback may keep the mesh by swapping it out.
+ *
+ * pSpecs		- the trees to generate
+ * pCallback	- function called for each finished tree
+ * pData		- data passed to our callback
+ **/
+void forest::generate(const std::vector<treespec>& pSpecs, meshCallback pCallback, void* pData) {
+	if (mThreadPool == NULL) {
+		mThreadPool = new threadpool(mNumThreads);
+	};
+	
+	forestJob job;
+	job.owner = this;
+	job.specs = &pSpecs;
+	job.callback = pCallback;
+	job.data = pData;
+	mThreadPool->run(runTreeJob, &job, pSpecs.size());
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * buildTree(pSpec, pMesh, pNumThreads, pReport)
+ *
+ * Runs all stages for a single tree and places the resulting mesh in pMesh. This is the one place our trees are
+ * built so the same spec always gives the same tree, whoever asks for it.
+ *
+ * pSpec		- our tree
+ * pMesh		- receives our mesh
+ * pNumThreads	- -1 to build our tree on the calling thread, otherwise the number of threads to grow it on (0 = one per core)
+ * pReport		- if not NULL receives our timings and counts
+ **/
+void forest::buildTree(const treespec& pSpec, treemesh& pMesh, int pNumThreads, buildreport* pReport) {
+	TREES_TRACE_SCOPE("buildTree");
+	treebuilder tree;
+	buildreport report;
+	
+	tree.setSeed(pSpec.seed);
+	tree.setSearchMode(pSpec.searchMode);
+	tree.setLazyChildCount(true);
+	tree.setBatchOptimise(true);
+	tree.setOptimiseVertexCache(pSpec.optimiseVertexCache);
+	if (pNumThreads >= 0) {
+		// when we build a forest each tree runs on a single thread, we're already running in parallel with other trees
+		tree.setParallel(true);
+		tree.setNumThreads(pNumThreads);
+	};
+	
+	double stageStart = treestats::now();
+	tree.growBranch(0, pSpec.trunk);
+	for (unsigned long c = 0; c < pSpec.clouds.size(); c++) {
+		const cloudspec& cloud = pSpec.clouds[c];
+		tree.generateAttractionPoints(cloud.numOfPoints, cloud.outerRadius, cloud.innerRadius, cloud.aspect, cloud.offsetY, c == 0);
+	};
+	report.pointsTime = treestats::now() - stageStart;
+	
+	stageStart = treestats::now();
+	for (unsigned long s = 0; s < pSpec.stages.size(); s++) {
+		const growspec& stage = pSpec.stages[s];
+		while (tree.doIteration(stage.maxDistance, stage.branchSize, stage.cutOffDistance, stage.bias)) {
+			report.iterations++;
+		};
+	};
+	report.growTime = treestats::now() - stageStart;
+	report.grownNodes = tree.numOfNodes();
+	
+	stageStart = treestats::now();
+	if (pSpec.optimise) {
+		tree.optimiseNodes();
+	};
+	report.optimiseTime = treestats::now() - stageStart;
+	report.numOfNodes = tree.numOfNodes();
+	
+	stageStart = treestats::now();
+	tree.setMinRadius(pSpec.minRadius);
+	tree.setRadiusFactor(pSpec.radiusFactor);
+	tree.setLeafSize(pSpec.leafSize);
+	tree.createModel();
+	tree.takeMesh(pMesh);
+	report.modelTime = treestats::now() - stageStart;
+	
+	if (pReport != NULL) {
+		report.peakMemory = tree.peakMemory();
+		report.cacheStats = tree.cacheStats();
+		report.stats = tree.stats();
+		*pReport = report;
+	};
+};
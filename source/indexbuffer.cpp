@@ -0,0 +1,115 @@
+/********************************************************************
+ * indexbuffer holds our elements as 16 bit indices ready to be
+ * uploaded to the GPU
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "indexbuffer.h"
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long indexbuffer::size() const {
+	return mIndices.size();
+};
+
+const unsigned short* indexbuffer::data() const {
+	return mIndices.data();
+};
+
+const std::vector<indexchunk>& indexbuffer::chunks() const {
+	return mChunks;
+};
+
+unsigned long indexbuffer::memoryUsed() const {
+	return (mIndices.capacity() * sizeof(unsigned short)) + (mChunks.capacity() * sizeof(indexchunk));
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+void indexbuffer::clear() {
+	std::vector<unsigned short>().swap(mIndices);
+	std::vector<indexchunk>().swap(mChunks);
+};
+
+/**
+ * build(pIndices, pNumOfPrimitives, pPrimitiveSize)
+ *
+ * Converts our 32 bit indices to 16 bit indices. We keep adding primitives to our current chunk until one uses a
+ * vertex our chunk can't reach, then we start a new chunk. Primitives are never split or reordered so drawing our
+ * chunks one after the other draws exactly what our 32 bit indices did.
+ * Returns false and leaves us empty if we'd need too many chunks, our 32 bit indices should be used instead.
+ *
+ * pIndices			- pPrimitiveSize vertex indices for each primitive
+ * pNumOfPrimitives	- number of primitives in pIndices
+ * pPrimitiveSize	- number of vertices per primitive
+ **/
+bool indexbuffer::build(const unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize) {
+	unsigned long numOfIndices = pNumOfPrimitives * pPrimitiveSize;
+	clear();
+
+	if (numOfIndices == 0) {
+		return false;
+	};
+
+	// first find our chunks
+	indexchunk chunk;
+	chunk.first = 0;
+	unsigned long minVertex = pIndices[0];
+	unsigned long maxVertex = pIndices[0];
+	for (unsigned long p = 0; p < pNumOfPrimitives; p++) {
+		const unsigned int* primitive = pIndices + (p * pPrimitiveSize);
+		unsigned long primitiveMin = primitive[0];
+		unsigned long primitiveMax = primitive[0];
+		for (int i = 1; i < pPrimitiveSize; i++) {
+			primitiveMin = (primitive[i] < primitiveMin ? primitive[i] : primitiveMin);
+			primitiveMax = (primitive[i] > primitiveMax ? primitive[i] : primitiveMax);
+		};
+
+		if (primitiveMax - primitiveMin >= INDEXBUFFER_MAX_RANGE) {
+			// no chunk can reach all of this primitive
+			clear();
+			return false;
+		};
+
+		unsigned long newMin = (primitiveMin < minVertex ? primitiveMin : minVertex);
+		unsigned long newMax = (primitiveMax > maxVertex ? primitiveMax : maxVertex);
+		if (newMax - newMin >= INDEXBUFFER_MAX_RANGE) {
+			// our chunk ends here
+			chunk.count = (p * pPrimitiveSize) - chunk.first;
+			chunk.baseVertex = minVertex;
+			mChunks.push_back(chunk);
+
+			chunk.first = p * pPrimitiveSize;
+			newMin = primitiveMin;
+			newMax = primitiveMax;
+		};
+
+		minVertex = newMin;
+		maxVertex = newMax;
+	};
+	chunk.count = numOfIndices - chunk.first;
+	chunk.baseVertex = minVertex;
+	mChunks.push_back(chunk);
+
+	// each chunk is a separate draw call, if our chunks are tiny that costs more than our 32 bit indices do
+	if ((mChunks.size() > 1) && (numOfIndices / mChunks.size() < INDEXBUFFER_MIN_CHUNK_SIZE)) {
+		clear();
+		return false;
+	};
+
+	// now write our indices
+	mIndices.resize(numOfIndices);
+	for (unsigned long c = 0; c < mChunks.size(); c++) {
+		const indexchunk& current = mChunks[c];
+		for (unsigned long i = current.first; i < current.first + current.count; i++) {
+			mIndices[i] = (unsigned short) (pIndices[i] - current.baseVertex);
+		};
+	};
+
+	return true;
+};
@@ -0,0 +1,531 @@
+/********************************************************************
+ * meshexport writes our tree meshes to standard file formats
+ *
+ * We stream straight from our arrays into a fixed size buffer that we
+ * write to our file descriptor whenever it fills up so we never build
+ * the whole file in memory. Numbers are formatted by hand as printf
+ * is by far the slowest part of writing a large OBJ file.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "meshexport.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// glTF constants we use
+#define		GLTF_FLOAT				5126
+#define		GLTF_UNSIGNED_INT		5125
+#define		GLTF_ARRAY_BUFFER		34962
+#define		GLTF_ELEMENT_BUFFER		34963
+
+static bool isLittleEndian() {
+	unsigned int test = 1;
+	return *((unsigned char*) &test) == 1;
+};
+
+/////////////////////////////////////////////////////////////////////
+// exportbuffer
+/////////////////////////////////////////////////////////////////////
+
+exportbuffer::exportbuffer(int pFile) {
+	mFile = pFile;
+	mUsed = 0;
+	mFailed = false;
+};
+
+exportbuffer::~exportbuffer() {
+	flush();
+};
+
+bool exportbuffer::failed() const {
+	return mFailed;
+};
+
+/**
+ * writeAll(pData, pSize)
+ *
+ * Writes pData to our file, write may write less than we ask so we keep going until it's all out
+ **/
+void exportbuffer::writeAll(const char* pData, unsigned long pSize) {
+	while (!mFailed && (pSize > 0)) {
+		ssize_t written = ::write(mFile, pData, pSize);
+		if (written > 0) {
+			pData += written;
+			pSize -= written;
+		} else if ((written == -1) && (errno == EINTR)) {
+			// interrupted, just try again
+		} else {
+			mFailed = true;
+		};
+	};
+};
+
+/**
+ * put(pData, pSize)
+ *
+ * Adds pSize bytes to our buffer, writing our buffer out when it's full
+ **/
+void exportbuffer::put(const void* pData, unsigned long pSize) {
+	const char* data = (const char*) pData;
+
+	if (mUsed + pSize > EXPORTBUFFER_SIZE) {
+		flush();
+
+		if (pSize > EXPORTBUFFER_SIZE) {
+			// no point in copying this into our buffer
+			writeAll(data, pSize);
+			return;
+		};
+	};
+
+	memcpy(mBuffer + mUsed, data, pSize);
+	mUsed += pSize;
+};
+
+void exportbuffer::put(const char* pText) {
+	put(pText, strlen(pText));
+};
+
+void exportbuffer::putChar(char pChar) {
+	if (mUsed == EXPORTBUFFER_SIZE) {
+		flush();
+	};
+
+	mBuffer[mUsed++] = pChar;
+};
+
+void exportbuffer::putUnsigned(unsigned long pValue) {
+	char text[32];
+	put(text, formatUnsigned(pValue, text));
+};
+
+void exportbuffer::putFloat(float pValue) {
+	char text[64];
+	put(text, formatFloat(pValue, text));
+};
+
+/**
+ * flush()
+ *
+ * Writes out whatever is in our buffer, returns false if any write so far has failed
+ **/
+bool exportbuffer::flush() {
+	writeAll(mBuffer, mUsed);
+	mUsed = 0;
+
+	return !mFailed;
+};
+
+/**
+ * formatUnsigned(pValue, pOut)
+ *
+ * Writes pValue as a decimal number to pOut and returns the number of characters written, pOut is not zero terminated
+ **/
+int exportbuffer::formatUnsigned(unsigned long pValue, char* pOut) {
+	char digits[32];
+	int len = 0;
+
+	do {
+		digits[len++] = '0' + (pValue % 10);
+		pValue /= 10;
+	} while (pValue > 0);
+
+	for (int i = 0; i < len; i++) {
+		pOut[i] = digits[len - 1 - i];
+	};
+
+	return len;
+};
+
+/**
+ * formatFloat(pValue, pOut)
+ *
+ * Writes pValue to pOut exactly as printf("%f") would and returns the number of characters written, pOut is not
+ * zero terminated and must hold at least 64 characters.
+ * A float has a 24 bit mantissa and 1000000 fits in 20 bits so our value times 1000000 is exact as a double,
+ * rounding that to an integer rounds the same way printf does.
+ **/
+int exportbuffer::formatFloat(float pValue, char* pOut) {
+	double value = pValue;
+	double scaled = fabs(value) * 1000000.0;
+
+	if ((value != value) || !(scaled < 9.0e18)) {
+		// nan, infinite or too large to fit our integer, these don't show up in our meshes
+		char text[512];
+		int len = snprintf(text, sizeof(text), "%f", value);
+		len = (len < 63 ? len : 63);
+		memcpy(pOut, text, len);
+		return len;
+	};
+
+	unsigned long long fixed = (unsigned long long) nearbyint(scaled);
+	unsigned long long whole = fixed / 1000000;
+	unsigned long fraction = (unsigned long) (fixed % 1000000);
+	int len = 0;
+
+	// printf keeps the sign of negative numbers that round to 0
+	if (signbit(value)) {
+		pOut[len++] = '-';
+	};
+
+	char digits[32];
+	int numDigits = 0;
+	do {
+		digits[numDigits++] = '0' + (whole % 10);
+		whole /= 10;
+	} while (whole > 0);
+	while (numDigits > 0) {
+		pOut[len++] = digits[--numDigits];
+	};
+
+	pOut[len++] = '.';
+	for (int i = 5; i >= 0; i--) {
+		pOut[len + i] = '0' + (fraction % 10);
+		fraction /= 10;
+	};
+
+	return len + 6;
+};
+
+/////////////////////////////////////////////////////////////////////
+// meshexport
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * writeOBJ(pMesh, pFile)
+ *
+ * Writes our mesh as a Wavefront OBJ file, our bark quads and leaf triangles end up in separate groups
+ **/
+bool meshexport::writeOBJ(const treemesh& pMesh, int pFile) {
+	exportbuffer out(pFile);
+
+	out.put("# generated by treebatch\n");
+	for (unsigned long v = 0; v < pMesh.vertices.size(); v++) {
+		out.put("v ");
+		out.putFloat(pMesh.vertices[v].x);
+		out.putChar(' ');
+		out.putFloat(pMesh.vertices[v].y);
+		out.putChar(' ');
+		out.putFloat(pMesh.vertices[v].z);
+		out.putChar('\n');
+	};
+	for (unsigned long v = 0; v < pMesh.normals.size(); v++) {
+		out.put("vn ");
+		out.putFloat(pMesh.normals[v].x);
+		out.putChar(' ');
+		out.putFloat(pMesh.normals[v].y);
+		out.putChar(' ');
+		out.putFloat(pMesh.normals[v].z);
+		out.putChar('\n');
+	};
+	for (unsigned long v = 0; v < pMesh.texCoords.size(); v++) {
+		out.put("vt ");
+		out.putFloat(pMesh.texCoords[v].x);
+		out.putChar(' ');
+		out.putFloat(pMesh.texCoords[v].y);
+		out.putChar('\n');
+	};
+
+	// OBJ indices start at 1, we use the same index for our position, texture coordinate and normal
+	char text[128];
+	out.put("g bark\n");
+	for (unsigned long e = 0; e < pMesh.treeElements.size(); e++) {
+		out.putChar('f');
+		for (int i = 0; i < 4; i++) {
+			int len = exportbuffer::formatUnsigned(pMesh.treeElements[e].v[i] + 1, text + 1);
+			text[0] = ' ';
+			text[len + 1] = '/';
+			memcpy(text + len + 2, text + 1, len);
+			text[2 * len + 2] = '/';
+			memcpy(text + 2 * len + 3, text + 1, len);
+			out.put(text, 3 * len + 3);
+		};
+		out.putChar('\n');
+	};
+
+	out.put("g leaves\n");
+	for (unsigned long e = 0; e < pMesh.leafElements.size(); e++) {
+		out.putChar('f');
+		for (int i = 0; i < 3; i++) {
+			int len = exportbuffer::formatUnsigned(pMesh.leafElements[e].v[i] + 1, text + 1);
+			text[0] = ' ';
+			text[len + 1] = '/';
+			memcpy(text + len + 2, text + 1, len);
+			text[2 * len + 2] = '/';
+			memcpy(text + 2 * len + 3, text + 1, len);
+			out.put(text, 3 * len + 3);
+		};
+		out.putChar('\n');
+	};
+
+	return out.flush();
+};
+
+/**
+ * writePLY(pMesh, pFile)
+ *
+ * Writes our mesh as a binary PLY file in our native byte order. Each vertex has its position, normal and
+ * texture coordinate, our faces are our bark quads followed by our leaf triangles.
+ **/
+bool meshexport::writePLY(const treemesh& pMesh, int pFile) {
+	exportbuffer out(pFile);
+
+	out.put("ply\n");
+	out.put(isLittleEndian() ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n");
+	out.put("comment generated by treebatch\n");
+	out.put("element vertex ");
+	out.putUnsigned(pMesh.vertices.size());
+	out.put("\nproperty float x\nproperty float y\nproperty float z\n");
+	out.put("property float nx\nproperty float ny\nproperty float nz\n");
+	out.put("property float s\nproperty float t\n");
+	out.put("element face ");
+	out.putUnsigned(pMesh.treeElements.size() + pMesh.leafElements.size());
+	out.put("\nproperty list uchar uint vertex_indices\n");
+	out.put("end_header\n");
+
+	// interleave our vertex data
+	for (unsigned long v = 0; v < pMesh.vertices.size(); v++) {
+		float vertex[8];
+		vertex[0] = pMesh.vertices[v].x;
+		vertex[1] = pMesh.vertices[v].y;
+		vertex[2] = pMesh.vertices[v].z;
+		vertex[3] = pMesh.normals[v].x;
+		vertex[4] = pMesh.normals[v].y;
+		vertex[5] = pMesh.normals[v].z;
+		vertex[6] = pMesh.texCoords[v].x;
+		vertex[7] = pMesh.texCoords[v].y;
+		out.put(vertex, sizeof(vertex));
+	};
+
+	for (unsigned long e = 0; e < pMesh.treeElements.size(); e++) {
+		out.putChar(4);
+		out.put(pMesh.treeElements[e].v, 4 * sizeof(unsigned int));
+	};
+	for (unsigned long e = 0; e < pMesh.leafElements.size(); e++) {
+		out.putChar(3);
+		out.put(pMesh.leafElements[e].v, 3 * sizeof(unsigned int));
+	};
+
+	return out.flush();
+};
+
+/**
+ * writeGLB(pMesh, pFile)
+ *
+ * Writes our mesh as a binary glTF 2.0 file. glTF has no quads so we split our bark quads into two triangles,
+ * our bark and leaves become two primitives of a single mesh sharing our vertex buffers. A mesh without bark or
+ * without leaves leaves out that primitive and its indices.
+ * glTF is always little endian, we don't support writing it on big endian machines.
+ **/
+bool meshexport::writeGLB(const treemesh& pMesh, int pFile) {
+	if (!isLittleEndian()) {
+		return false;
+	};
+
+	unsigned long numVerts = pMesh.vertices.size();
+	unsigned long numBarkIndices = pMesh.treeElements.size() * 6;
+	unsigned long numLeafIndices = pMesh.leafElements.size() * 3;
+
+	// glTF requires the bounds of our positions
+	vec3 minPos(0.0f, 0.0f, 0.0f);
+	vec3 maxPos(0.0f, 0.0f, 0.0f);
+	for (unsigned long v = 0; v < numVerts; v++) {
+		const vec3& pos = pMesh.vertices[v];
+		if (v == 0) {
+			minPos = pos;
+			maxPos = pos;
+		} else {
+			minPos.x = (pos.x < minPos.x ? pos.x : minPos.x);
+			minPos.y = (pos.y < minPos.y ? pos.y : minPos.y);
+			minPos.z = (pos.z < minPos.z ? pos.z : minPos.z);
+			maxPos.x = (pos.x > maxPos.x ? pos.x : maxPos.x);
+			maxPos.y = (pos.y > maxPos.y ? pos.y : maxPos.y);
+			maxPos.z = (pos.z > maxPos.z ? pos.z : maxPos.z);
+		};
+	};
+
+	// glTF doesn't allow empty buffer views or accessors, or a mesh without primitives, so we leave out whatever we
+	// don't have. Without any elements our vertices aren't used either and we write an empty node.
+	if ((numBarkIndices == 0) && (numLeafIndices == 0)) {
+		numVerts = 0;
+	};
+
+	// our binary chunk holds our positions, normals, texture coordinates, bark indices and leaf indices in that order,
+	// everything is a multiple of 4 bytes so we never need padding
+	unsigned long long viewSize[5];
+	viewSize[0] = numVerts * sizeof(vec3);
+	viewSize[1] = numVerts * sizeof(vec3);
+	viewSize[2] = numVerts * sizeof(vec2);
+	viewSize[3] = numBarkIndices * sizeof(unsigned int);
+	viewSize[4] = numLeafIndices * sizeof(unsigned int);
+	unsigned long long binSize = viewSize[0] + viewSize[1] + viewSize[2] + viewSize[3] + viewSize[4];
+
+	// each view we write gets an accessor with the same index
+	unsigned long accessorCount[5] = { numVerts, numVerts, numVerts, numBarkIndices, numLeafIndices };
+	const char* accessorType[5] = { "VEC3", "VEC3", "VEC2", "SCALAR", "SCALAR" };
+	int accessor[5];
+	int numAccessors = 0;
+	for (int b = 0; b < 5; b++) {
+		accessor[b] = (viewSize[b] > 0 ? numAccessors++ : -1);
+	};
+
+	// our JSON is small so we can just build it in memory
+	std::string json;
+	char text[512];
+	json += "{\"asset\":{\"version\":\"2.0\",\"generator\":\"treebatch\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],";
+	if (numAccessors == 0) {
+		json += "\"nodes\":[{}]}";
+	} else {
+		json += "\"nodes\":[{\"mesh\":0}],";
+		json += "\"materials\":[{\"name\":\"bark\"},{\"name\":\"leaves\",\"doubleSided\":true}],";
+		json += "\"meshes\":[{\"primitives\":[";
+		if (numBarkIndices > 0) {
+			sprintf(text, "{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":%d,\"material\":0}", accessor[3]);
+			json += text;
+		};
+		if (numLeafIndices > 0) {
+			sprintf(text, "%s{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":%d,\"material\":1}", numBarkIndices > 0 ? "," : "", accessor[4]);
+			json += text;
+		};
+		json += "]}],";
+
+		sprintf(text, "\"buffers\":[{\"byteLength\":%llu}],\"bufferViews\":[", binSize);
+		json += text;
+		unsigned long long offset = 0;
+		for (int b = 0; b < 5; b++) {
+			if (accessor[b] != -1) {
+				sprintf(text, "%s{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":%d}", accessor[b] > 0 ? "," : "", offset, viewSize[b], b < 3 ? GLTF_ARRAY_BUFFER : GLTF_ELEMENT_BUFFER);
+				json += text;
+				offset += viewSize[b];
+			};
+		};
+		json += "],\"accessors\":[";
+
+		for (int b = 0; b < 5; b++) {
+			if (accessor[b] != -1) {
+				sprintf(text, "%s{\"bufferView\":%d,\"componentType\":%d,\"count\":%lu,\"type\":\"%s\"", accessor[b] > 0 ? "," : "", accessor[b], b < 3 ? GLTF_FLOAT : GLTF_UNSIGNED_INT, accessorCount[b], accessorType[b]);
+				json += text;
+				if (b == 0) {
+					sprintf(text, ",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]", minPos.x, minPos.y, minPos.z, maxPos.x, maxPos.y, maxPos.z);
+					json += text;
+				};
+				json += "}";
+			};
+		};
+		json += "]}";
+	};
+
+	// our JSON chunk must be padded with spaces to a multiple of 4 bytes
+	while ((json.size() % 4) != 0) {
+		json += ' ';
+	};
+
+	// and we only write our binary chunk if we have something to put in it
+	unsigned int header[5];
+	header[0] = 0x46546C67; // glTF
+	header[1] = 2;
+	header[2] = 12 + 8 + json.size() + (binSize > 0 ? 8 + binSize : 0);
+	header[3] = json.size();
+	header[4] = 0x4E4F534A; // JSON
+
+	exportbuffer out(pFile);
+	out.put(header, sizeof(header));
+	out.put(json.data(), json.size());
+	if (binSize == 0) {
+		return out.flush();
+	};
+
+	unsigned int binHeader[2];
+	binHeader[0] = binSize;
+	binHeader[1] = 0x004E4942; // BIN
+
+	out.put(binHeader, sizeof(binHeader));
+	out.put(pMesh.vertices.data(), viewSize[0]);
+	out.put(pMesh.normals.data(), viewSize[1]);
+	out.put(pMesh.texCoords.data(), viewSize[2]);
+
+	for (unsigned long e = 0; e < pMesh.treeElements.size(); e++) {
+		const unsigned int* v = pMesh.treeElements[e].v;
+		unsigned int indices[6];
+		indices[0] = v[0];
+		indices[1] = v[1];
+		indices[2] = v[2];
+		indices[3] = v[0];
+		indices[4] = v[2];
+		indices[5] = v[3];
+		out.put(indices, sizeof(indices));
+	};
+	out.put(pMesh.leafElements.data(), viewSize[4]);
+
+	return out.flush();
+};
+
+/**
+ * write(pMesh, pFile, pFormat)
+ *
+ * Writes our mesh to pFile in pFormat
+ **/
+bool meshexport::write(const treemesh& pMesh, int pFile, exportFormats pFormat) {
+	switch (pFormat) {
+		case export_ply: {
+			return writePLY(pMesh, pFile);
+		} break;
+		case export_glb: {
+			return writeGLB(pMesh, pFile);
+		} break;
+		default: {
+			return writeOBJ(pMesh, pFile);
+		} break;
+	};
+};
+
+/**
+ * write(pMesh, pFileName, pFormat)
+ *
+ * Creates pFileName and writes our mesh to it in pFormat
+ **/
+bool meshexport::write(const treemesh& pMesh, const std::string& pFileName, exportFormats pFormat) {
+	int file = open(pFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file == -1) {
+		return false;
+	};
+
+	bool success = write(pMesh, file, pFormat);
+	if (close(file) != 0) {
+		success = false;
+	};
+
+	return success;
+};
+
+/**
+ * formatFromFileName(pFileName, pFormat)
+ *
+ * Sets pFormat based on the extension of pFileName, returns false if we don't recognise it
+ **/
+bool meshexport::formatFromFileName(const std::string& pFileName, exportFormats& pFormat) {
+	size_t dot = pFileName.rfind('.');
+	if (dot == std::string::npos) {
+		return false;
+	};
+
+	std::string extension = pFileName.substr(dot);
+	if (strcasecmp(extension.c_str(), ".obj") == 0) {
+		pFormat = export_obj;
+	} else if (strcasecmp(extension.c_str(), ".ply") == 0) {
+		pFormat = export_ply;
+	} else if (strcasecmp(extension.c_str(), ".glb") == 0) {
+		pFormat = export_glb;
+	} else {
+		return false;
+	};
+
+	return true;
+};
@@ -0,0 +1,442 @@
+/********************************************************************
+ * meshfile reads and writes our binary tree mesh format
+ *
+ * The file starts with a header and a table of sections, each section
+ * holds one array of our mesh exactly as we have it in memory and
+ * starts on a 64 byte boundary. We map the file into memory and hand
+ * out pointers straight into it so loading a tree doesn't parse or
+ * copy anything, the arrays can be passed to glBufferData as is.
+ *
+ * All values are stored in the byte order of the machine that wrote
+ * the file, we refuse to open files written in another byte order.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "meshfile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define		MESHFILE_MAGIC			"TREEMESH"
+#define		MESHFILE_BYTEORDER		0x01020304
+
+// our sections are the raw arrays of our mesh so these must have exactly the layout we store
+typedef char checkVec3Size[(sizeof(vec3) == 12) ? 1 : -1];
+typedef char checkVec2Size[(sizeof(vec2) == 8) ? 1 : -1];
+typedef char checkQuadSize[(sizeof(quad) == 16) ? 1 : -1];
+typedef char checkTriangleSize[(sizeof(triangle) == 12) ? 1 : -1];
+typedef char checkNodeSize[(sizeof(meshnode) == 16) ? 1 : -1];
+typedef char checkSectionSize[(sizeof(meshsection) == 24) ? 1 : -1];
+typedef char checkHeaderSize[(sizeof(meshheader) == 24) ? 1 : -1];
+
+// a section we're about to write
+class sectionSource {
+public:
+	unsigned int		type;
+	unsigned int		elementSize;
+	unsigned long long	count;
+	const void*			data;
+};
+
+static unsigned long long alignOffset(unsigned long long pOffset) {
+	return (pOffset + MESHFILE_ALIGNMENT - 1) & ~((unsigned long long) MESHFILE_ALIGNMENT - 1);
+};
+
+static void addSection(std::vector<sectionSource>& pSources, unsigned int pType, unsigned int pElementSize, unsigned long long pCount, const void* pData) {
+	sectionSource source;
+	source.type = pType;
+	source.elementSize = pElementSize;
+	source.count = pCount;
+	source.data = pData;
+	pSources.push_back(source);
+};
+
+/////////////////////////////////////////////////////////////////////
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+meshfile::meshfile() {
+	mData = NULL;
+	mSize = 0;
+	mSections = NULL;
+	mNumSections = 0;
+};
+
+meshfile::~meshfile() {
+	close();
+};
+
+/////////////////////////////////////////////////////////////////////
+// sections
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * findSection(pType, pElementSize)
+ *
+ * Returns the entry in our section table for pType, NULL if we don't have it or its elements aren't the size we expect
+ **/
+const meshsection* meshfile::findSection(unsigned int pType, unsigned int pElementSize) const {
+	for (unsigned int s = 0; s < mNumSections; s++) {
+		if ((mSections[s].type == pType) && (mSections[s].elementSize == pElementSize)) {
+			return &mSections[s];
+		};
+	};
+
+	return NULL;
+};
+
+/**
+ * sectionData(pType, pElementSize, pCount)
+ *
+ * Returns a pointer to the data of section pType within our mapping and sets pCount to its number of elements.
+ * Returns NULL and sets pCount to 0 if we don't have this section.
+ **/
+const void* meshfile::sectionData(unsigned int pType, unsigned int pElementSize, unsigned long& pCount) const {
+	const meshsection* section = findSection(pType, pElementSize);
+	if (section == NULL) {
+		pCount = 0;
+		return NULL;
+	};
+
+	pCount = section->count;
+	return (const char*) mData + section->offset;
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+bool meshfile::isOpen() const {
+	return mData != NULL;
+};
+
+unsigned long meshfile::numOfVertices() const {
+	unsigned long count;
+	sectionData(section_vertices, sizeof(vec3), count);
+	return count;
+};
+
+const vec3* meshfile::vertices() const {
+	unsigned long count;
+	return (const vec3*) sectionData(section_vertices, sizeof(vec3), count);
+};
+
+const vec3* meshfile::normals() const {
+	unsigned long count;
+	return (const vec3*) sectionData(section_normals, sizeof(vec3), count);
+};
+
+const vec2* meshfile::texCoords() const {
+	unsigned long count;
+	return (const vec2*) sectionData(section_texcoords, sizeof(vec2), count);
+};
+
+unsigned long meshfile::numOfTreeElements() const {
+	unsigned long count;
+	sectionData(section_tree_elements, sizeof(quad), count);
+	return count;
+};
+
+const quad* meshfile::treeElements() const {
+	unsigned long count;
+	return (const quad*) sectionData(section_tree_elements, sizeof(quad), count);
+};
+
+unsigned long meshfile::numOfLeafElements() const {
+	unsigned long count;
+	sectionData(section_leaf_elements, sizeof(triangle), count);
+	return count;
+};
+
+const triangle* meshfile::leafElements() const {
+	unsigned long count;
+	return (const triangle*) sectionData(section_leaf_elements, sizeof(triangle), count);
+};
+
+unsigned long meshfile::numOfSkeletonVertices() const {
+	unsigned long count;
+	sectionData(section_skeleton_vertices, sizeof(vec3), count);
+	return count;
+};
+
+const vec3* meshfile::skeletonVertices() const {
+	unsigned long count;
+	return (const vec3*) sectionData(section_skeleton_vertices, sizeof(vec3), count);
+};
+
+unsigned long meshfile::numOfSkeletonNodes() const {
+	unsigned long count;
+	sectionData(section_skeleton_nodes, sizeof(meshnode), count);
+	return count;
+};
+
+const meshnode* meshfile::skeletonNodes() const {
+	unsigned long count;
+	return (const meshnode*) sectionData(section_skeleton_nodes, sizeof(meshnode), count);
+};
+
+unsigned long meshfile::keySize() const {
+	unsigned long count;
+	sectionData(section_key, 1, count);
+	return count;
+};
+
+const unsigned char* meshfile::key() const {
+	unsigned long count;
+	return (const unsigned char*) sectionData(section_key, 1, count);
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * open(pFileName)
+ *
+ * Maps pFileName into memory and checks our header and section table, returns false if the file doesn't
+ * exist or isn't a mesh file we can read. We don't read any of our data until it is accessed, use validate
+ * to check our indices.
+ **/
+bool meshfile::open(const std::string& pFileName) {
+	close();
+
+	int fd = ::open(pFileName.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	};
+
+	struct stat info;
+	if ((fstat(fd, &info) != 0) || ((unsigned long long) info.st_size < sizeof(meshheader))) {
+		::close(fd);
+		return false;
+	};
+
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	// our mapping stays valid after we close our file
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	};
+
+	mData = data;
+	mSize = info.st_size;
+
+	const meshheader* header = (const meshheader*) mData;
+	bool success = (memcmp(header->magic, MESHFILE_MAGIC, 8) == 0);
+	success = success && (header->version == MESHFILE_VERSION) && (header->byteOrder == MESHFILE_BYTEORDER);
+	success = success && (sizeof(meshheader) + (unsigned long long) header->numSections * sizeof(meshsection) <= mSize);
+
+	if (success) {
+		mSections = (const meshsection*) ((const char*) mData + sizeof(meshheader));
+		mNumSections = header->numSections;
+
+		// make sure every section lies within our file and is aligned, checking the size without overflowing
+		for (unsigned int s = 0; success && (s < mNumSections); s++) {
+			const meshsection& section = mSections[s];
+			success = (section.elementSize > 0) && ((section.offset % MESHFILE_ALIGNMENT) == 0) && (section.offset <= mSize);
+			success = success && (section.count <= (mSize - section.offset) / section.elementSize);
+		};
+	};
+
+	// our vertex streams must all be there and have the same length
+	if (success) {
+		unsigned long numVerts = numOfVertices();
+		unsigned long count;
+		success = (vertices() != NULL);
+		success = success && (sectionData(section_normals, sizeof(vec3), count) != NULL) && (count == numVerts);
+		success = success && (sectionData(section_texcoords, sizeof(vec2), count) != NULL) && (count == numVerts);
+	};
+
+	if (!success) {
+		close();
+	};
+
+	return success;
+};
+
+/**
+ * close()
+ *
+ * Unmaps our file, any pointers we've handed out are no longer valid
+ **/
+void meshfile::close() {
+	if (mData != NULL) {
+		munmap(mData, mSize);
+		mData = NULL;
+	};
+
+	mSize = 0;
+	mSections = NULL;
+	mNumSections = 0;
+};
+
+/**
+ * validate()
+ *
+ * Returns false if any of our elements or skeleton nodes refer to a vertex or node we don't have. open only
+ * checks that our sections lie within our file, checking our indices means reading all of them so we leave
+ * that to whoever writes our file and calls this once on the result.
+ **/
+bool meshfile::validate() const {
+	if (!isOpen()) {
+		return false;
+	};
+
+	unsigned long numVerts = numOfVertices();
+
+	const quad* quads = treeElements();
+	unsigned long numQuads = numOfTreeElements();
+	for (unsigned long q = 0; q < numQuads; q++) {
+		for (int i = 0; i < 4; i++) {
+			if (quads[q].v[i] >= numVerts) {
+				return false;
+			};
+		};
+	};
+
+	const triangle* triangles = leafElements();
+	unsigned long numTriangles = numOfLeafElements();
+	for (unsigned long t = 0; t < numTriangles; t++) {
+		for (int i = 0; i < 3; i++) {
+			if (triangles[t].v[i] >= numVerts) {
+				return false;
+			};
+		};
+	};
+
+	unsigned long numSkeletonVerts = numOfSkeletonVertices();
+	const meshnode* nodes = skeletonNodes();
+	unsigned long numNodes = numOfSkeletonNodes();
+	for (unsigned long n = 0; n < numNodes; n++) {
+		if ((nodes[n].a >= numSkeletonVerts) || (nodes[n].b >= numSkeletonVerts)) {
+			return false;
+		};
+		if ((nodes[n].parent < -1) || ((nodes[n].parent >= 0) && ((unsigned long) nodes[n].parent >= numNodes))) {
+			return false;
+		};
+	};
+
+	return true;
+};
+
+/**
+ * copyTo(pMesh)
+ *
+ * Copies our mesh into pMesh for when we need to change it or keep it after closing our file
+ **/
+void meshfile::copyTo(treemesh& pMesh) const {
+	pMesh.clear();
+	if (!isOpen()) {
+		return;
+	};
+
+	unsigned long numVerts = numOfVertices();
+	pMesh.vertices.assign(vertices(), vertices() + numVerts);
+	pMesh.normals.assign(normals(), normals() + numVerts);
+	pMesh.texCoords.assign(texCoords(), texCoords() + numVerts);
+
+	if (treeElements() != NULL) {
+		pMesh.treeElements.assign(treeElements(), treeElements() + numOfTreeElements());
+	};
+	if (leafElements() != NULL) {
+		pMesh.leafElements.assign(leafElements(), leafElements() + numOfLeafElements());
+	};
+	if (skeletonVertices() != NULL) {
+		pMesh.skeletonVertices.assign(skeletonVertices(), skeletonVertices() + numOfSkeletonVertices());
+	};
+
+	const meshnode* nodes = skeletonNodes();
+	unsigned long numNodes = numOfSkeletonNodes();
+	pMesh.skeletonNodes.resize(numNodes);
+	for (unsigned long n = 0; n < numNodes; n++) {
+		pMesh.skeletonNodes[n].a = nodes[n].a;
+		pMesh.skeletonNodes[n].b = nodes[n].b;
+		pMesh.skeletonNodes[n].parent = nodes[n].parent;
+		pMesh.skeletonNodes[n].childcount = nodes[n].childcount;
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * write(pFileName, pMesh, pKey)
+ *
+ * Writes pMesh to pFileName in our format, returns false if we couldn't write our file
+ *
+ * pFileName	- file to write to, this is overwritten if it exists
+ * pMesh		- mesh to write
+ * pKey			- optional bytes to store in our key section
+ **/
+bool meshfile::write(const std::string& pFileName, const treemesh& pMesh, const std::vector<unsigned char>* pKey) {
+	// our skeleton nodes need converting to fixed size fields
+	std::vector<meshnode> nodes(pMesh.skeletonNodes.size());
+	for (unsigned long n = 0; n < nodes.size(); n++) {
+		nodes[n].a = pMesh.skeletonNodes[n].a;
+		nodes[n].b = pMesh.skeletonNodes[n].b;
+		nodes[n].parent = pMesh.skeletonNodes[n].parent;
+		nodes[n].childcount = pMesh.skeletonNodes[n].childcount;
+	};
+
+	std::vector<sectionSource> sources;
+	addSection(sources, section_vertices, sizeof(vec3), pMesh.vertices.size(), pMesh.vertices.data());
+	addSection(sources, section_normals, sizeof(vec3), pMesh.normals.size(), pMesh.normals.data());
+	addSection(sources, section_texcoords, sizeof(vec2), pMesh.texCoords.size(), pMesh.texCoords.data());
+	addSection(sources, section_tree_elements, sizeof(quad), pMesh.treeElements.size(), pMesh.treeElements.data());
+	addSection(sources, section_leaf_elements, sizeof(triangle), pMesh.leafElements.size(), pMesh.leafElements.data());
+	addSection(sources, section_skeleton_vertices, sizeof(vec3), pMesh.skeletonVertices.size(), pMesh.skeletonVertices.data());
+	addSection(sources, section_skeleton_nodes, sizeof(meshnode), nodes.size(), nodes.data());
+	if (pKey != NULL) {
+		addSection(sources, section_key, 1, pKey->size(), pKey->data());
+	};
+
+	meshheader header;
+	memcpy(header.magic, MESHFILE_MAGIC, 8);
+	header.version = MESHFILE_VERSION;
+	header.byteOrder = MESHFILE_BYTEORDER;
+	header.numSections = sources.size();
+	header.reserved = 0;
+
+	// lay out our sections one after the other, each starting on our alignment
+	std::vector<meshsection> sections(sources.size());
+	unsigned long long offset = sizeof(meshheader) + sources.size() * sizeof(meshsection);
+	for (unsigned long s = 0; s < sources.size(); s++) {
+		offset = alignOffset(offset);
+		sections[s].type = sources[s].type;
+		sections[s].elementSize = sources[s].elementSize;
+		sections[s].offset = offset;
+		sections[s].count = sources[s].count;
+		offset += sources[s].count * sources[s].elementSize;
+	};
+
+	FILE* file = fopen(pFileName.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	};
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(sections.data(), sizeof(meshsection), sections.size(), file);
+
+	char padding[MESHFILE_ALIGNMENT];
+	memset(padding, 0, MESHFILE_ALIGNMENT);
+	offset = sizeof(meshheader) + sources.size() * sizeof(meshsection);
+	for (unsigned long s = 0; s < sources.size(); s++) {
+		fwrite(padding, 1, sections[s].offset - offset, file);
+		fwrite(sources[s].data, sources[s].elementSize, sources[s].count, file);
+		offset = sections[s].offset + sources[s].count * sources[s].elementSize;
+	};
+
+	bool success = (ferror(file) == 0);
+	if (fclose(file) != 0) {
+		success = false;
+	};
+
+	return success;
+};
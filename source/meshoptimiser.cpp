@@ -0,0 +1,292 @@
+/********************************************************************
+ * meshoptimiser reorders our meshes so the GPU renders them faster
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "meshoptimiser.h"
+
+cachestats::cachestats() {
+	treeBefore = 0.0f;
+	treeAfter = 0.0f;
+	leafBefore = 0.0f;
+	leafAfter = 0.0f;
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+bool meshoptimiser::cluster::operator<(const cluster& pOther) const {
+	// ties are broken on our position so our order never depends on our sort
+	if (sortKey != pOther.sortKey) {
+		return sortKey > pOther.sortKey;
+	};
+	return first < pOther.first;
+};
+
+/**
+ * nextVertex(pCandidates, pLive, pCacheTime, pTime, pCacheSize)
+ *
+ * Picks the vertex Tipsify fans around next out of the vertices of the primitives we just emitted. We prefer
+ * the vertex that has been in our cache longest as long as it will still be in our cache once we've emitted
+ * all of its remaining primitives. Returns -1 if none of our candidates have primitives left.
+ **/
+long meshoptimiser::nextVertex(const std::vector<unsigned int>& pCandidates, const std::vector<unsigned int>& pLive, const std::vector<unsigned int>& pCacheTime, unsigned int pTime, unsigned long pCacheSize) {
+	long best = -1;
+	long bestPriority = -1;
+
+	for (unsigned long c = 0; c < pCandidates.size(); c++) {
+		unsigned int v = pCandidates[c];
+		if (pLive[v] > 0) {
+			// Tipsify assumes each remaining primitive adds 2 new vertices to our cache but in the grids our branches
+			// are made of it is closer to 1, which gives us a lower ACMR for both our patches and our triangles
+			long priority = 0;
+			if (pTime - pCacheTime[v] + pLive[v] <= pCacheSize) {
+				priority = pTime - pCacheTime[v];
+			};
+
+			if (priority > bestPriority) {
+				best = v;
+				bestPriority = priority;
+			};
+		};
+	};
+
+	return best;
+};
+
+/**
+ * sortClusters(pIndices, pPrimitiveSize, pVertices, pClusters)
+ *
+ * Sorts our clusters so those facing away from the center of our mesh are drawn first, these are most likely
+ * to hide whatever is drawn after them. We sort on the dot product of the direction from the center of our mesh
+ * to the center of our cluster and the average normal of our cluster.
+ **/
+void meshoptimiser::sortClusters(unsigned int* pIndices, int pPrimitiveSize, const std::vector<vec3>& pVertices, std::vector<cluster>& pClusters) {
+	unsigned long numOfClusters = pClusters.size();
+	std::vector<vec3> centers(numOfClusters);
+	std::vector<vec3> normals(numOfClusters);
+	vec3 meshCenter(0.0f, 0.0f, 0.0f);
+	unsigned long numOfPrimitives = 0;
+
+	for (unsigned long c = 0; c < numOfClusters; c++) {
+		vec3 center(0.0f, 0.0f, 0.0f);
+		vec3 normal(0.0f, 0.0f, 0.0f);
+
+		for (unsigned long p = pClusters[c].first; p < pClusters[c].first + pClusters[c].count; p++) {
+			const unsigned int* primitive = pIndices + (p * pPrimitiveSize);
+			vec3 primitiveCenter(0.0f, 0.0f, 0.0f);
+			for (int i = 0; i < pPrimitiveSize; i++) {
+				primitiveCenter += pVertices[primitive[i]];
+			};
+			center += primitiveCenter / (float) pPrimitiveSize;
+
+			// the cross product of our diagonals (or of two edges for a triangle) gives us our normal weighted by our area
+			vec3 a = pVertices[primitive[2]] - pVertices[primitive[0]];
+			vec3 b = pVertices[primitive[pPrimitiveSize - 1]] - pVertices[primitive[1]];
+			normal += a * b;
+		};
+
+		meshCenter += center;
+		numOfPrimitives += pClusters[c].count;
+		centers[c] = center / (float) pClusters[c].count;
+		normals[c] = normal.normalized();
+	};
+	meshCenter /= (float) numOfPrimitives;
+
+	for (unsigned long c = 0; c < numOfClusters; c++) {
+		pClusters[c].sortKey = (centers[c] - meshCenter) % normals[c];
+	};
+	std::sort(pClusters.begin(), pClusters.end());
+
+	// and put our primitives in the order of our clusters
+	std::vector<unsigned int> sorted(numOfPrimitives * pPrimitiveSize);
+	unsigned long i = 0;
+	for (unsigned long c = 0; c < numOfClusters; c++) {
+		const unsigned int* first = pIndices + (pClusters[c].first * pPrimitiveSize);
+		for (unsigned long j = 0; j < pClusters[c].count * pPrimitiveSize; j++) {
+			sorted[i++] = first[j];
+		};
+	};
+	std::copy(sorted.begin(), sorted.end(), pIndices);
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * acmr(pIndices, pNumOfPrimitives, pPrimitiveSize, pNumOfVertices, pCacheSize)
+ *
+ * Simulates a FIFO vertex cache of pCacheSize vertices and returns the number of cache misses per primitive
+ **/
+float meshoptimiser::acmr(const unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize, unsigned long pNumOfVertices, unsigned long pCacheSize) {
+	if (pNumOfPrimitives == 0) {
+		return 0.0f;
+	};
+
+	// a vertex is in our cache if fewer than pCacheSize vertices were added after it
+	std::vector<unsigned long> cacheTime(pNumOfVertices, 0);
+	unsigned long time = pCacheSize + 1;
+	unsigned long misses = 0;
+
+	for (unsigned long i = 0; i < pNumOfPrimitives * pPrimitiveSize; i++) {
+		unsigned int v = pIndices[i];
+		if (time - cacheTime[v] > pCacheSize) {
+			cacheTime[v] = time++;
+			misses++;
+		};
+	};
+
+	return (float) misses / (float) pNumOfPrimitives;
+};
+
+/**
+ * optimiseOrder(pIndices, pNumOfPrimitives, pPrimitiveSize, pVertices, pCacheSize)
+ *
+ * Reorders our primitives in place for a vertex cache of pCacheSize vertices. We emit all remaining primitives
+ * around a vertex and then move on to one of the vertices of those primitives that is still in our cache. If
+ * none are left we've hit a dead end, that's where each of our clusters starts. Our primitives keep the order
+ * of their vertices so our winding doesn't change.
+ * This can be called for part of a mesh to keep its primitives within that part.
+ *
+ * pIndices			- pPrimitiveSize vertex indices for each primitive
+ * pNumOfPrimitives	- number of primitives in pIndices
+ * pPrimitiveSize	- number of vertices per primitive, 3 for triangles, 4 for our patches
+ * pVertices		- our vertices, only used to sort our clusters
+ * pCacheSize		- size of the vertex cache we optimise for
+ **/
+void meshoptimiser::optimiseOrder(unsigned int* pIndices, unsigned long pNumOfPrimitives, int pPrimitiveSize, const std::vector<vec3>& pVertices, unsigned long pCacheSize) {
+	unsigned long numOfIndices = pNumOfPrimitives * pPrimitiveSize;
+	if (pNumOfPrimitives == 0) {
+		return;
+	};
+
+	// we only need room for the range of vertices our primitives use, that is a lot less than our whole mesh if we're
+	// called for a part of it
+	unsigned int firstVertex = pIndices[0];
+	unsigned int lastVertex = pIndices[0];
+	for (unsigned long i = 1; i < numOfIndices; i++) {
+		firstVertex = (pIndices[i] < firstVertex ? pIndices[i] : firstVertex);
+		lastVertex = (pIndices[i] > lastVertex ? pIndices[i] : lastVertex);
+	};
+	unsigned long numOfVertices = lastVertex - firstVertex + 1;
+
+	// count the primitives using each vertex, these are the primitives we haven't emitted yet
+	std::vector<unsigned int> live(numOfVertices, 0);
+	for (unsigned long i = 0; i < numOfIndices; i++) {
+		live[pIndices[i] - firstVertex]++;
+	};
+
+	// and build a list of the primitives using each vertex
+	std::vector<unsigned int> adjacencyStart(numOfVertices + 1, 0);
+	for (unsigned long v = 0; v < numOfVertices; v++) {
+		adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+	};
+	std::vector<unsigned int> adjacency(numOfIndices);
+	std::vector<unsigned int> next(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned long i = 0; i < numOfIndices; i++) {
+		adjacency[next[pIndices[i] - firstVertex]++] = i / pPrimitiveSize;
+	};
+
+	std::vector<unsigned int> cacheTime(numOfVertices, 0);
+	std::vector<unsigned char> emitted(pNumOfPrimitives, 0);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	std::vector<cluster> clusters;
+	unsigned int time = pCacheSize + 1;
+	unsigned long cursor = 0;
+	long fanning = pIndices[0] - firstVertex;
+	output.reserve(numOfIndices);
+	deadEnd.reserve(numOfIndices);
+
+	cluster newCluster;
+	newCluster.first = 0;
+	newCluster.sortKey = 0.0f;
+	clusters.push_back(newCluster);
+
+	while (fanning >= 0) {
+		// emit all remaining primitives around our vertex
+		candidates.clear();
+		for (unsigned long a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+			unsigned long p = adjacency[a];
+			if (!emitted[p]) {
+				for (int i = 0; i < pPrimitiveSize; i++) {
+					unsigned int v = pIndices[(p * pPrimitiveSize) + i] - firstVertex;
+					output.push_back(v + firstVertex);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - cacheTime[v] > pCacheSize) {
+						cacheTime[v] = time++;
+					};
+				};
+				emitted[p] = 1;
+			};
+		};
+
+		fanning = nextVertex(candidates, live, cacheTime, time, pCacheSize);
+		if (fanning == -1) {
+			// dead end, try the vertices we've recently emitted
+			while ((fanning == -1) && !deadEnd.empty()) {
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0) {
+					fanning = v;
+				};
+			};
+
+			// and otherwise the next vertex that still has primitives left
+			while ((fanning == -1) && (cursor < numOfVertices)) {
+				if (live[cursor] > 0) {
+					fanning = cursor;
+				};
+				cursor++;
+			};
+
+			// our next cluster starts here
+			if (fanning != -1) {
+				newCluster.first = output.size() / pPrimitiveSize;
+				clusters.push_back(newCluster);
+			};
+		};
+	};
+
+	std::copy(output.begin(), output.end(), pIndices);
+
+	for (unsigned long c = 0; c < clusters.size(); c++) {
+		unsigned long end = (c + 1 < clusters.size() ? clusters[c + 1].first : pNumOfPrimitives);
+		clusters[c].count = end - clusters[c].first;
+	};
+	sortClusters(pIndices, pPrimitiveSize, pVertices, clusters);
+};
+
+/**
+ * fetchOrder(pIndices, pNumOfIndices, pNewIndex, pNext)
+ *
+ * Gives each vertex in pIndices that doesn't have a new index yet the next new index in the order they are used.
+ * Fill pNewIndex with MESHOPTIMISER_UNUSED before the first call, returns the next new index we'd hand out.
+ **/
+unsigned long meshoptimiser::fetchOrder(const unsigned int* pIndices, unsigned long pNumOfIndices, std::vector<unsigned long>& pNewIndex, unsigned long pNext) {
+	for (unsigned long i = 0; i < pNumOfIndices; i++) {
+		unsigned int v = pIndices[i];
+		if (pNewIndex[v] == MESHOPTIMISER_UNUSED) {
+			pNewIndex[v] = pNext++;
+		};
+	};
+
+	return pNext;
+};
+
+/**
+ * remapIndices(pIndices, pNumOfIndices, pNewIndex)
+ *
+ * Changes each index to its new index
+ **/
+void meshoptimiser::remapIndices(unsigned int* pIndices, unsigned long pNumOfIndices, const std::vector<unsigned long>& pNewIndex) {
+	for (unsigned long i = 0; i < pNumOfIndices; i++) {
+		pIndices[i] = pNewIndex[pIndices[i]];
+	};
+};
@@ -0,0 +1,233 @@
+/********************************************************************
+ * packedvertices holds our vertices interleaved in a compact layout
+ * ready to be uploaded to the GPU
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "packedvertices.h"
+
+packedvertices::packedvertices() {
+	mCount = 0;
+	setFormat(vertex_planar);
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+vertexFormats packedvertices::format() const {
+	return mFormat;
+};
+
+/**
+ * setFormat(pFormat)
+ *
+ * Changes our layout, this clears our vertices. With vertex_planar we don't hold any vertices.
+ **/
+void packedvertices::setFormat(vertexFormats pFormat) {
+	mFormat = pFormat;
+	mStride = (mFormat == vertex_packed_half ? 16 : 20);
+	clear();
+};
+
+unsigned long packedvertices::stride() const {
+	return mStride;
+};
+
+unsigned long packedvertices::normalOffset() const {
+	return (mFormat == vertex_packed_half ? 8 : 12);
+};
+
+unsigned long packedvertices::texCoordOffset() const {
+	return normalOffset() + 4;
+};
+
+unsigned long packedvertices::size() const {
+	return mCount;
+};
+
+const unsigned char* packedvertices::data() const {
+	return mData.data();
+};
+
+unsigned long packedvertices::memoryUsed() const {
+	return mData.capacity();
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+void packedvertices::clear() {
+	std::vector<unsigned char>().swap(mData);
+	mCount = 0;
+};
+
+/**
+ * resize(pCount)
+ *
+ * Makes room for exactly pCount vertices, ignored if our format is vertex_planar
+ **/
+void packedvertices::resize(unsigned long pCount) {
+	if (mFormat != vertex_planar) {
+		mData.resize(pCount * mStride);
+		mCount = pCount;
+	};
+};
+
+/**
+ * set(pIndex, pPosition, pNormal, pTexCoord)
+ *
+ * Packs our vertex into slot pIndex, this is safe to call from multiple threads as long as they write different slots
+ **/
+void packedvertices::set(unsigned long pIndex, const vec3& pPosition, const vec3& pNormal, const vec2& pTexCoord) {
+	unsigned char* vertex = mData.data() + (pIndex * mStride);
+
+	if (mFormat == vertex_packed_half) {
+		unsigned short position[4];
+		position[0] = toHalf(pPosition.x);
+		position[1] = toHalf(pPosition.y);
+		position[2] = toHalf(pPosition.z);
+		position[3] = 0;
+		memcpy(vertex, position, sizeof(position));
+	} else {
+		float position[3];
+		position[0] = pPosition.x;
+		position[1] = pPosition.y;
+		position[2] = pPosition.z;
+		memcpy(vertex, position, sizeof(position));
+	};
+
+	short normal[2];
+	encodeNormal(pNormal, normal);
+	memcpy(vertex + normalOffset(), normal, sizeof(normal));
+
+	unsigned short texCoord[2];
+	texCoord[0] = toUnorm16(pTexCoord.u);
+	texCoord[1] = toUnorm16(pTexCoord.v / PACKED_TEXCOORD_RANGE);
+	memcpy(vertex + texCoordOffset(), texCoord, sizeof(texCoord));
+};
+
+/**
+ * reorder(pNewIndex)
+ *
+ * Moves vertex n to slot pNewIndex[n], pNewIndex must give each vertex a different slot
+ **/
+void packedvertices::reorder(const std::vector<unsigned long>& pNewIndex) {
+	if (mFormat != vertex_planar) {
+		std::vector<unsigned char> reordered(mData.size());
+		for (unsigned long v = 0; v < mCount; v++) {
+			memcpy(reordered.data() + (pNewIndex[v] * mStride), mData.data() + (v * mStride), mStride);
+		};
+		mData.swap(reordered);
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * toHalf(pValue)
+ *
+ * Converts a float to a half float rounding to the nearest value (ties to even) like the GPU does
+ **/
+unsigned short packedvertices::toHalf(float pValue) {
+	unsigned int bits;
+	memcpy(&bits, &pValue, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int) ((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF) {
+		// infinity stays infinity, NaN stays NaN
+		return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+	} else if (exponent >= 31) {
+		// too large, becomes infinity
+		return sign | 0x7C00;
+	} else if (exponent <= 0) {
+		// too small for a normal half, becomes a denormal or 0
+		if (exponent < -10) {
+			return sign;
+		};
+
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1 << shift) - 1);
+		unsigned int halfway = 1 << (shift - 1);
+		if ((rest > halfway) || ((rest == halfway) && ((half & 1) != 0))) {
+			half++;
+		};
+
+		return sign | half;
+	} else {
+		// a rounding carry moves on into our exponent which is exactly what we want
+		unsigned int half = (exponent << 10) | (mantissa >> 13);
+		unsigned int rest = mantissa & 0x1FFF;
+		if ((rest > 0x1000) || ((rest == 0x1000) && ((half & 1) != 0))) {
+			half++;
+		};
+
+		return sign | half;
+	};
+};
+
+/**
+ * encodeNormal(pNormal, pEncoded)
+ *
+ * Projects our normal onto an octahedron which we unfold into a square, pEncoded gets its 2 coordinates as snorm16
+ **/
+void packedvertices::encodeNormal(const vec3& pNormal, short* pEncoded) {
+	float length = fabsf(pNormal.x) + fabsf(pNormal.y) + fabsf(pNormal.z);
+	float x = 0.0f;
+	float y = 0.0f;
+
+	if (length > 0.0f) {
+		x = pNormal.x / length;
+		y = pNormal.y / length;
+
+		if (pNormal.z < 0.0f) {
+			// fold our lower half over our upper half
+			float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		};
+	};
+
+	x = (x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x));
+	y = (y < -1.0f ? -1.0f : (y > 1.0f ? 1.0f : y));
+	pEncoded[0] = (short) floorf((x * 32767.0f) + 0.5f);
+	pEncoded[1] = (short) floorf((y * 32767.0f) + 0.5f);
+};
+
+/**
+ * decodeNormal(pEncoded)
+ *
+ * Turns an encoded normal back into a unit vector, our shaders do exactly the same
+ **/
+vec3 packedvertices::decodeNormal(const short* pEncoded) {
+	float x = pEncoded[0] / 32767.0f;
+	float y = pEncoded[1] / 32767.0f;
+	vec3 normal(x, y, 1.0f - fabsf(x) - fabsf(y));
+
+	if (normal.z < 0.0f) {
+		normal.x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		normal.y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+	};
+
+	return normal.normalized();
+};
+
+/**
+ * toUnorm16(pValue)
+ *
+ * Converts a value between 0.0 and 1.0 to a unorm16, values outside of that range are clamped
+ **/
+unsigned short packedvertices::toUnorm16(float pValue) {
+	pValue = (pValue < 0.0f ? 0.0f : (pValue > 1.0f ? 1.0f : pValue));
+	return (unsigned short) floorf((pValue * 65535.0f) + 0.5f);
+};
@@ -0,0 +1,280 @@
+/********************************************************************
+ * pointcloud stores our attraction points as separate arrays
+ *
+ * Keeping our x, y and z coordinates in separate arrays allows us to
+ * test 8 attraction points against a vertex at once using AVX2 (or 4
+ * using SSE4.1). Which kernel we use is decided at runtime so we still
+ * run on CPUs without these instruction sets.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "pointcloud.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define		POINTCLOUD_X86
+#include <immintrin.h>
+#endif
+
+// we check our CPU once, the first thread to need our kernel does so while any others wait
+static pthread_once_t kernelDetected = PTHREAD_ONCE_INIT;
+static int supportedKernel = kernel_scalar;				// best kernel our CPU supports
+static int selectedKernel = -1;							// kernel forced by setKernel, -1 to use supportedKernel
+
+/**
+ * detectKernel()
+ *
+ * Checks which kernels our CPU supports, called through pthread_once
+ **/
+static void detectKernel() {
+#ifdef POINTCLOUD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		supportedKernel = kernel_avx2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		supportedKernel = kernel_sse4;
+	};
+#endif
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long pointcloud::size() const {
+	return x.size();
+};
+
+unsigned long pointcloud::memoryUsed() const {
+	return ((x.capacity() + y.capacity() + z.capacity() + distance.capacity()) * sizeof(float)) + (closest.capacity() * sizeof(unsigned long));
+};
+
+/////////////////////////////////////////////////////////////////////
+// kernels
+//
+// All kernels must give exactly the same result as vec3::length()
+// so we calculate (x * x) + (y * y) + (z * z) in that order and take
+// the square root before comparing. As we only look at vertices
+// added after all our closest vertices we never need to check for
+// ties.
+/////////////////////////////////////////////////////////////////////
+
+void pointcloud::findClosestScalar(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	unsigned long numVerts = pVertices.size();
+
+	for (unsigned long i = pFrom; i < pTo; i++) {
+		float px = x[i];
+		float py = y[i];
+		float pz = z[i];
+
+		for (unsigned long v = pFirstVertex; v < numVerts; v++) {
+			float dx = pVertices[v].x - px;
+			float dy = pVertices[v].y - py;
+			float dz = pVertices[v].z - pz;
+			float l = (dx * dx) + (dy * dy) + (dz * dz);
+			float d = (l == 0.0f ? 0.0f : sqrt(l));
+			if (d < distance[i]) {
+				closest[i] = v;
+				distance[i] = d;
+			};
+		};
+	};
+};
+
+#ifdef POINTCLOUD_X86
+
+__attribute__((target("sse4.1")))
+void pointcloud::findClosestSSE4(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	unsigned long numVerts = pVertices.size();
+	unsigned long i = pFrom;
+	int lanes[4];
+
+	for (; i + 4 <= pTo; i += 4) {
+		__m128 px = _mm_loadu_ps(&x[i]);
+		__m128 py = _mm_loadu_ps(&y[i]);
+		__m128 pz = _mm_loadu_ps(&z[i]);
+		__m128 best = _mm_loadu_ps(&distance[i]);
+		__m128 bestVertex = _mm_castsi128_ps(_mm_set1_epi32(-1)); // -1 means unchanged
+
+		for (unsigned long v = pFirstVertex; v < numVerts; v++) {
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(pVertices[v].x), px);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(pVertices[v].y), py);
+			__m128 dz = _mm_sub_ps(_mm_set1_ps(pVertices[v].z), pz);
+			__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 d = _mm_sqrt_ps(squared);
+
+			__m128 closer = _mm_cmplt_ps(d, best);
+			best = _mm_blendv_ps(best, d, closer);
+			bestVertex = _mm_blendv_ps(bestVertex, _mm_castsi128_ps(_mm_set1_epi32((int) v)), closer);
+		};
+
+		_mm_storeu_ps(&distance[i], best);
+		_mm_storeu_si128((__m128i*) lanes, _mm_castps_si128(bestVertex));
+		for (int l = 0; l < 4; l++) {
+			if (lanes[l] != -1) {
+				closest[i + l] = lanes[l];
+			};
+		};
+	};
+
+	// and finish off any points that are left
+	findClosestScalar(pVertices, pFirstVertex, i, pTo);
+};
+
+__attribute__((target("avx2")))
+void pointcloud::findClosestAVX2(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	unsigned long numVerts = pVertices.size();
+	unsigned long i = pFrom;
+	int lanes[8];
+
+	for (; i + 8 <= pTo; i += 8) {
+		__m256 px = _mm256_loadu_ps(&x[i]);
+		__m256 py = _mm256_loadu_ps(&y[i]);
+		__m256 pz = _mm256_loadu_ps(&z[i]);
+		__m256 best = _mm256_loadu_ps(&distance[i]);
+		__m256 bestVertex = _mm256_castsi256_ps(_mm256_set1_epi32(-1)); // -1 means unchanged
+
+		for (unsigned long v = pFirstVertex; v < numVerts; v++) {
+			__m256 dx = _mm256_sub_ps(_mm256_set1_ps(pVertices[v].x), px);
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(pVertices[v].y), py);
+			__m256 dz = _mm256_sub_ps(_mm256_set1_ps(pVertices[v].z), pz);
+			__m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+			__m256 d = _mm256_sqrt_ps(squared);
+
+			__m256 closer = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+			best = _mm256_blendv_ps(best, d, closer);
+			bestVertex = _mm256_blendv_ps(bestVertex, _mm256_castsi256_ps(_mm256_set1_epi32((int) v)), closer);
+		};
+
+		_mm256_storeu_ps(&distance[i], best);
+		_mm256_storeu_si256((__m256i*) lanes, _mm256_castps_si256(bestVertex));
+		for (int l = 0; l < 8; l++) {
+			if (lanes[l] != -1) {
+				closest[i + l] = lanes[l];
+			};
+		};
+	};
+
+	// and finish off any points that are left
+	findClosestScalar(pVertices, pFirstVertex, i, pTo);
+};
+
+#else
+
+void pointcloud::findClosestSSE4(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	findClosestScalar(pVertices, pFirstVertex, pFrom, pTo);
+};
+
+void pointcloud::findClosestAVX2(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	findClosestScalar(pVertices, pFirstVertex, pFrom, pTo);
+};
+
+#endif
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+void pointcloud::clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	closest.clear();
+	distance.clear();
+};
+
+/**
+ * load(pPoints)
+ *
+ * Copies our attraction points into our arrays, our distances are left at 0.0
+ **/
+void pointcloud::load(const std::vector<attractionPoint>& pPoints) {
+	unsigned long numPoints = pPoints.size();
+
+	x.resize(numPoints);
+	y.resize(numPoints);
+	z.resize(numPoints);
+	closest.resize(numPoints);
+	distance.assign(numPoints, 0.0f);
+
+	for (unsigned long i = 0; i < numPoints; i++) {
+		x[i] = pPoints[i].position.x;
+		y[i] = pPoints[i].position.y;
+		z[i] = pPoints[i].position.z;
+		closest[i] = pPoints[i].closestVertice;
+	};
+};
+
+/**
+ * compact(pRemove)
+ *
+ * Removes the points marked in pRemove keeping the rest in order
+ **/
+void pointcloud::compact(const std::vector<unsigned char>& pRemove) {
+	unsigned long i = 0;
+
+	for (unsigned long p = 0; p < pRemove.size(); p++) {
+		if (!pRemove[p]) {
+			x[i] = x[p];
+			y[i] = y[p];
+			z[i] = z[p];
+			closest[i] = closest[p];
+			distance[i] = distance[p];
+			i++;
+		};
+	};
+
+	x.resize(i);
+	y.resize(i);
+	z.resize(i);
+	closest.resize(i);
+	distance.resize(i);
+};
+
+/**
+ * findClosest(pVertices, pFirstVertex, pFrom, pTo)
+ *
+ * Tests attraction points pFrom to pTo-1 against vertices pFirstVertex and up, updating closest and distance
+ * for each point that has a vertex closer than its current closest. All vertices tested must have a higher
+ * index than the closest vertice we've got for any point.
+ **/
+void pointcloud::findClosest(const std::vector<vec3>& pVertices, unsigned long pFirstVertex, unsigned long pFrom, unsigned long pTo) {
+	switch (kernel()) {
+		case kernel_avx2: {
+			findClosestAVX2(pVertices, pFirstVertex, pFrom, pTo);
+		} break;
+		case kernel_sse4: {
+			findClosestSSE4(pVertices, pFirstVertex, pFrom, pTo);
+		} break;
+		default: {
+			findClosestScalar(pVertices, pFirstVertex, pFrom, pTo);
+		} break;
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * kernel()
+ *
+ * Returns the kernel findClosest uses, the best one our CPU supports unless setKernel forced another
+ **/
+pointKernels pointcloud::kernel() {
+	pthread_once(&kernelDetected, detectKernel);
+
+	return (pointKernels) (selectedKernel == -1 ? supportedKernel : selectedKernel);
+};
+
+/**
+ * setKernel(pKernel)
+ *
+ * Forces the use of a specific kernel, if our CPU doesn't support it we use the best one it does support.
+ * Call this before any trees are being grown.
+ **/
+void pointcloud::setKernel(pointKernels pKernel) {
+	pthread_once(&kernelDetected, detectKernel);
+
+	selectedKernel = (pKernel < supportedKernel ? pKernel : supportedKernel);
+};
@@ -0,0 +1,143 @@
+/********************************************************************
+ * pointgrid is a uniform hash grid over our attraction points
+ *
+ * It allows us to find the attraction points that are near to a
+ * vertex without testing every attraction point we have.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "pointgrid.h"
+
+pointgrid::pointgrid() {
+	mCellSize = 1.0f;
+	mMask = 0;
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+float pointgrid::cellSize() {
+	return mCellSize;
+};
+
+unsigned long pointgrid::memoryUsed() const {
+	return (mStart.capacity() + mIndices.capacity()) * sizeof(unsigned long);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+long pointgrid::cell(float pValue) const {
+	return (long) floor(pValue / mCellSize);
+};
+
+unsigned long pointgrid::bucket(long pX, long pY, long pZ) const {
+	// large primes, see "Optimized Spatial Hashing for Collision Detection of Deformable Objects" by Teschner et al.
+	unsigned long hash = ((unsigned long) pX * 73856093UL) ^ ((unsigned long) pY * 19349663UL) ^ ((unsigned long) pZ * 83492791UL);
+	return hash & mMask;
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * clear()
+ *
+ * Releases the memory held by our grid
+ **/
+void pointgrid::clear() {
+	mMask = 0;
+	mStart.clear();
+	mIndices.clear();
+};
+
+/**
+ * build(pPoints, pCellSize)
+ *
+ * (Re)builds our grid for the given attraction points. Buckets are stored back to back
+ * (a counting sort on bucket) so each bucket is a contiguous run of point indices.
+ *
+ * pPoints		- the attraction points to index
+ * pCellSize	- size of our cells, any point closer than this to a position is found by findNear
+ **/
+void pointgrid::build(const std::vector<attractionPoint>& pPoints, float pCellSize) {
+	unsigned long numPoints = pPoints.size();
+	unsigned long tableSize = 64;
+	std::vector<unsigned long> buckets;
+
+	// make our cells a fraction larger so rounding can never push a point within pCellSize two cells over
+	mCellSize = pCellSize * 1.001f + 0.001f;
+
+	// size our table to our number of points, we can never have more occupied cells than points
+	while (tableSize < numPoints) {
+		tableSize <<= 1;
+	};
+	mMask = tableSize - 1;
+
+	// count the number of points in each bucket
+	mStart.assign(tableSize + 1, 0);
+	buckets.resize(numPoints);
+	for (unsigned long i = 0; i < numPoints; i++) {
+		const vec3& position = pPoints[i].position;
+		buckets[i] = bucket(cell(position.x), cell(position.y), cell(position.z));
+		mStart[buckets[i] + 1]++;
+	};
+
+	// turn our counts into start offsets
+	for (unsigned long b = 0; b < tableSize; b++) {
+		mStart[b + 1] += mStart[b];
+	};
+
+	// and place our points
+	std::vector<unsigned long> cursor(mStart.begin(), mStart.end() - 1);
+	mIndices.resize(numPoints);
+	for (unsigned long i = 0; i < numPoints; i++) {
+		mIndices[cursor[buckets[i]]++] = i;
+	};
+};
+
+/**
+ * findNear(pPosition, pFound)
+ *
+ * Finds all attraction points in the cells surrounding pPosition. This will always include
+ * all points closer than our cell size but may include points further away.
+ *
+ * pPosition	- position we're searching around
+ * pFound		- indices of the attraction points found, this is cleared first
+ **/
+void pointgrid::findNear(const vec3& pPosition, std::vector<unsigned long>& pFound) const {
+	unsigned long visited[27];
+	int numVisited = 0;
+
+	pFound.clear();
+	if (mStart.empty()) {
+		return;
+	};
+
+	long cx = cell(pPosition.x);
+	long cy = cell(pPosition.y);
+	long cz = cell(pPosition.z);
+
+	for (long x = cx - 1; x <= cx + 1; x++) {
+		for (long y = cy - 1; y <= cy + 1; y++) {
+			for (long z = cz - 1; z <= cz + 1; z++) {
+				unsigned long b = bucket(x, y, z);
+
+				// different cells may hash to the same bucket, make sure we only add it once
+				bool duplicate = false;
+				for (int i = 0; i < numVisited && !duplicate; i++) {
+					duplicate = (visited[i] == b);
+				};
+
+				if (!duplicate) {
+					visited[numVisited++] = b;
+					pFound.insert(pFound.end(), mIndices.begin() + mStart[b], mIndices.begin() + mStart[b + 1]);
+				};
+			};
+		};
+	};
+};
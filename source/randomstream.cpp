@@ -0,0 +1,106 @@
+/********************************************************************
+ * randomstream is a seedable counter based random number generator
+ *
+ * Each number is a hash of our seed, our stream number and a counter
+ * so streams are independent of each other, two trees with the same
+ * seed get the same numbers and we can jump to any position in a
+ * stream without generating the numbers before it.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "randomstream.h"
+
+// the golden ratio in 64 bit fixed point, steps our counter through our hash
+#define		GOLDEN_GAMMA		0x9E3779B97F4A7C15ULL
+
+randomstream::randomstream() {
+	reset(0, 0);
+};
+
+randomstream::randomstream(unsigned long long pSeed, unsigned long long pStream) {
+	reset(pSeed, pStream);
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long long randomstream::counter() const {
+	return mCounter;
+};
+
+void randomstream::setCounter(unsigned long long pCounter) {
+	mCounter = pCounter;
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * reset(pSeed, pStream)
+ *
+ * Starts our stream over for the given seed and stream number
+ **/
+void randomstream::reset(unsigned long long pSeed, unsigned long long pStream) {
+	mKey = mix(pSeed ^ mix(pStream + GOLDEN_GAMMA));
+	mCounter = 0;
+};
+
+/**
+ * at(pCounter)
+ *
+ * Returns the number at position pCounter in our stream, this doesn't change our counter
+ **/
+unsigned long long randomstream::at(unsigned long long pCounter) const {
+	return mix(mKey + ((pCounter + 1) * GOLDEN_GAMMA));
+};
+
+/**
+ * next()
+ *
+ * Returns the next number in our stream
+ **/
+unsigned long long randomstream::next() {
+	return at(mCounter++);
+};
+
+/**
+ * randf(pMin, pMax)
+ *
+ * Returns the next number in our stream as a floating point number between pMin and pMax
+ **/
+float randomstream::randf(float pMin, float pMax) {
+	return toFloat(next(), pMin, pMax);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * mix(pValue)
+ *
+ * The SplitMix64 finalizer, scrambles all bits of pValue
+ **/
+unsigned long long randomstream::mix(unsigned long long pValue) {
+	pValue = (pValue ^ (pValue >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	pValue = (pValue ^ (pValue >> 27)) * 0x94D049BB133111EBULL;
+	return pValue ^ (pValue >> 31);
+};
+
+/**
+ * toFloat(pValue, pMin, pMax)
+ *
+ * Turns a random number into a floating point number between pMin and pMax
+ **/
+float randomstream::toFloat(unsigned long long pValue, float pMin, float pMax) {
+	float randomNumber;
+	
+	randomNumber = (float) (pValue >> 40); // random number between 0 and 2^24, exactly representable as a float
+	randomNumber /= 16777216.0f; // scale to 0.0 - 1.0
+	randomNumber *= (pMax - pMin); // scale to our delta
+	
+	return randomNumber + pMin; // and return a number between min and max
+};
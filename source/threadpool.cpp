@@ -0,0 +1,283 @@
+/********************************************************************
+ * threadpool runs batches of jobs on a set of worker threads
+ *
+ * Each worker starts off with its own share of the jobs in a batch,
+ * a worker that runs out steals half of the remaining jobs of another
+ * worker so we keep all our cores busy even if some jobs take much
+ * longer than others.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "threadpool.h"
+
+// parameters we hand to each worker thread
+class workerParam {
+public:
+	threadpool*		pool;
+	int				worker;
+};
+
+/////////////////////////////////////////////////////////////////////
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * threadpool(pNumThreads)
+ *
+ * Creates our pool, if pNumThreads is 0 we use one thread per core.
+ * Note that the thread calling run() also runs jobs so we start one thread less.
+ **/
+threadpool::threadpool(int pNumThreads) {
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mStartCond, NULL);
+	pthread_cond_init(&mDoneCond, NULL);
+
+	mFunction = NULL;
+	mData = NULL;
+	mNumJobs = 0;
+	mJobsDone = 0;
+	mBatch = 0;
+	mActive = 0;
+	mStopping = false;
+
+	if (pNumThreads <= 0) {
+		pNumThreads = numCores();
+	};
+
+	for (int t = 0; t < pNumThreads - 1; t++) {
+		workerParam* param = new workerParam();
+		param->pool = this;
+		param->worker = mThreads.size();
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, workerMain, param) == 0) {
+			mThreads.push_back(thread);
+		} else {
+			// we'll just have to do with fewer threads
+			delete param;
+		};
+	};
+	
+	// and a queue for each worker including the caller of run()
+	for (unsigned long q = 0; q <= mThreads.size(); q++) {
+		jobQueue* queue = new jobQueue();
+		pthread_mutex_init(&queue->mutex, NULL);
+		queue->next = 0;
+		queue->end = 0;
+		mQueues.push_back(queue);
+	};
+};
+
+threadpool::~threadpool() {
+	// tell our workers to stop and wait for them
+	pthread_mutex_lock(&mMutex);
+	mStopping = true;
+	pthread_cond_broadcast(&mStartCond);
+	pthread_mutex_unlock(&mMutex);
+
+	for (unsigned long t = 0; t < mThreads.size(); t++) {
+		pthread_join(mThreads[t], NULL);
+	};
+
+	for (unsigned long q = 0; q < mQueues.size(); q++) {
+		pthread_mutex_destroy(&mQueues[q]->mutex);
+		delete mQueues[q];
+	};
+
+	pthread_cond_destroy(&mDoneCond);
+	pthread_cond_destroy(&mStartCond);
+	pthread_mutex_destroy(&mMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+int threadpool::numThreads() {
+	return mThreads.size() + 1;
+};
+
+/////////////////////////////////////////////////////////////////////
+// workers
+/////////////////////////////////////////////////////////////////////
+
+void* threadpool::workerMain(void* pParam) {
+	workerParam* param = (workerParam*) pParam;
+	threadpool* pool = param->pool;
+	int worker = param->worker;
+	unsigned long lastBatch = 0;
+	delete param;
+
+	pthread_mutex_lock(&pool->mMutex);
+	while (true) {
+		// wait for a new batch
+		while (!pool->mStopping && (pool->mBatch == lastBatch)) {
+			pthread_cond_wait(&pool->mStartCond, &pool->mMutex);
+		};
+		if (pool->mStopping) {
+			break;
+		};
+
+		lastBatch = pool->mBatch;
+		pool->mActive++;
+		pthread_mutex_unlock(&pool->mMutex);
+		
+		pool->runJobs(worker);
+		
+		pthread_mutex_lock(&pool->mMutex);
+		pool->mActive--;
+		if (pool->mActive == 0) {
+			pthread_cond_broadcast(&pool->mDoneCond);
+		};
+	};
+	pthread_mutex_unlock(&pool->mMutex);
+
+	return NULL;
+};
+
+/**
+ * popJob(pWorker, pJob)
+ *
+ * Takes the next job from our own queue, returns false if we have none left
+ **/
+bool threadpool::popJob(int pWorker, unsigned long& pJob) {
+	jobQueue* queue = mQueues[pWorker];
+	bool found = false;
+	
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->next < queue->end) {
+		pJob = queue->next++;
+		found = true;
+	};
+	pthread_mutex_unlock(&queue->mutex);
+	
+	return found;
+};
+
+/**
+ * stealJob(pWorker, pJob)
+ *
+ * Steals half of the jobs another worker has left, we run the first one we steal and add the rest to our own queue.
+ * Returns false if no worker has any jobs left.
+ **/
+bool threadpool::stealJob(int pWorker, unsigned long& pJob) {
+	int numQueues = mQueues.size();
+	
+	for (int i = 1; i < numQueues; i++) {
+		jobQueue* victim = mQueues[(pWorker + i) % numQueues];
+		unsigned long from = 0;
+		unsigned long to = 0;
+		
+		pthread_mutex_lock(&victim->mutex);
+		if (victim->next < victim->end) {
+			unsigned long count = (victim->end - victim->next + 1) / 2;
+			to = victim->end;
+			from = to - count;
+			victim->end = from;
+		};
+		pthread_mutex_unlock(&victim->mutex);
+		
+		if (from < to) {
+			jobQueue* queue = mQueues[pWorker];
+			
+			pthread_mutex_lock(&queue->mutex);
+			queue->next = from + 1;
+			queue->end = to;
+			pthread_mutex_unlock(&queue->mutex);
+			
+			pJob = from;
+			return true;
+		};
+	};
+	
+	return false;
+};
+
+/**
+ * runJobs(pWorker)
+ *
+ * Keeps running jobs from our own queue and stealing jobs from others until there are none left.
+ **/
+void threadpool::runJobs(int pWorker) {
+	unsigned long job;
+	
+	while (popJob(pWorker, job) || stealJob(pWorker, job)) {
+		mFunction(mData, job, pWorker);
+		
+		if (__sync_add_and_fetch(&mJobsDone, 1) == mNumJobs) {
+			// we finished our last job, wake up whoever called run()
+			pthread_mutex_lock(&mMutex);
+			pthread_cond_broadcast(&mDoneCond);
+			pthread_mutex_unlock(&mMutex);
+		};
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * run(pFunction, pData, pNumJobs)
+ *
+ * Runs pNumJobs jobs on our workers and returns once all have finished.
+ * Jobs may run and finish in any order, pWorker is always < numThreads()
+ * and no two jobs with the same worker number run at the same time.
+ * Jobs must not call run() on the same pool.
+ *
+ * pFunction	- function to call for each job
+ * pData		- data passed to our function
+ * pNumJobs		- number of jobs to run
+ **/
+void threadpool::run(jobFunction pFunction, void* pData, unsigned long pNumJobs) {
+	if (pNumJobs == 0) {
+		return;
+	};
+
+	pthread_mutex_lock(&mMutex);
+	
+	// workers may still be looking for jobs from our last batch, we can't touch our queues until they're done
+	while (mActive > 0) {
+		pthread_cond_wait(&mDoneCond, &mMutex);
+	};
+
+	mFunction = pFunction;
+	mData = pData;
+	mNumJobs = pNumJobs;
+	mJobsDone = 0;
+	
+	// give each worker an equal share of our jobs
+	unsigned long numQueues = mQueues.size();
+	for (unsigned long q = 0; q < numQueues; q++) {
+		pthread_mutex_lock(&mQueues[q]->mutex);
+		mQueues[q]->next = (pNumJobs * q) / numQueues;
+		mQueues[q]->end = (pNumJobs * (q + 1)) / numQueues;
+		pthread_mutex_unlock(&mQueues[q]->mutex);
+	};
+	
+	mBatch++;
+	pthread_cond_broadcast(&mStartCond);
+	pthread_mutex_unlock(&mMutex);
+
+	// we help out as our last worker
+	runJobs(mThreads.size());
+
+	pthread_mutex_lock(&mMutex);
+
+	// and wait for the jobs others are still running
+	while (mJobsDone < mNumJobs) {
+		pthread_cond_wait(&mDoneCond, &mMutex);
+	};
+
+	pthread_mutex_unlock(&mMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+int threadpool::numCores() {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return (cores < 1 ? 1 : (int) cores);
+};
@@ -0,0 +1,264 @@
+/********************************************************************
+ * Our headless batch generator
+ *
+ * Runs all the stages of our tree generation back to back without
+ * needing a window or OpenGL and writes the resulting mesh to an
+ * OBJ file. Build with "make batch".
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treebatch.h"
+
+/**
+ * now()
+ *
+ * Returns the current time in milliseconds
+ **/
+double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+};
+
+/**
+ * writeMesh(pMesh, pFileName)
+ *
+ * Writes our mesh as a meshfile if our file name ends in .tree, otherwise we export it in the format matching
+ * our extension, OBJ if we don't recognise it
+ **/
+bool writeMesh(const treemesh& pMesh, const char* pFileName) {
+	size_t len = strlen(pFileName);
+	if ((len > 5) && (strcmp(pFileName + len - 5, ".tree") == 0)) {
+		return meshfile::write(pFileName, pMesh);
+	};
+	
+	exportFormats format = export_obj;
+	meshexport::formatFromFileName(pFileName, format);
+	return meshexport::write(pMesh, pFileName, format);
+};
+
+/**
+ * numberedFileName(pFileName, pNumber)
+ *
+ * Inserts our number before the extension of our file name, tree.obj becomes tree_12.obj
+ **/
+std::string numberedFileName(const char* pFileName, unsigned long pNumber) {
+	std::string fileName = pFileName;
+	char number[32];
+	sprintf(number, "_%lu", pNumber);
+	
+	size_t dot = fileName.rfind('.');
+	size_t slash = fileName.rfind('/');
+	if ((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash))) {
+		dot = fileName.size();
+	};
+	
+	return fileName.insert(dot, number);
+};
+
+// what we need to write the trees of our forest as they come in
+class forestOutput {
+public:
+	const char*		fileName;
+	unsigned long	numOfTrees;
+	unsigned long	numOfVertices;
+	bool			success;
+};
+
+void writeForestTree(void* pData, unsigned long pTree, treemesh& pMesh) {
+	forestOutput* output = (forestOutput*) pData;
+	std::string fileName = numberedFileName(output->fileName, pTree);
+	
+	if (writeMesh(pMesh, fileName.c_str())) {
+		output->numOfTrees++;
+		output->numOfVertices += pMesh.vertices.size();
+	} else {
+		fprintf(stderr, "Couldn't write %s\n", fileName.c_str());
+		output->success = false;
+	};
+};
+
+/**
+ * writeTrace(pFileName)
+ *
+ * Writes the events recorded by treetrace to pFileName
+ **/
+void writeTrace(const char* pFileName) {
+	if (!treetrace::enabled()) {
+		fprintf(stderr, "No trace was recorded, rebuild with TRACE=1\n");
+	};
+	if (!treetrace::write(pFileName)) {
+		fprintf(stderr, "Couldn't write %s\n", pFileName);
+	};
+};
+
+void usage() {
+	printf("Usage: treebatch [options]\n");
+	printf("  -o <file>      file to write our mesh to, the extension picks the format: .obj, .ply, .glb or .tree (default tree.obj)\n");
+	printf("  -p <points>    number of attraction points in our inner cloud (default 800)\n");
+	printf("  -s <mode>      search mode: brute, grid, kdtree or simd (default simd)\n");
+	printf("  -t <threads>   grow our tree, or our forest, in parallel on this many threads (0 = one per core)\n");
+	printf("  -r <seed>      seed for our random numbers, trees in a forest use seed, seed + 1, ... (default 0)\n");
+	printf("  -c <dir>       keep generated trees in a cache in this directory\n");
+	printf("  -m <MB>        maximum size of our cache, least recently used trees are removed first (default unlimited)\n");
+	printf("  -j <file>      write timings and counters as JSON, requires building with STATS=1\n");
+	printf("  -T <file>      write a trace that chrome://tracing or Perfetto can open, requires building with TRACE=1\n");
+	printf("  -n <trees>     generate a forest of trees in parallel, each is written to <file>_<n>\n");
+	printf("  -u             leave our mesh in the order we build it instead of optimising it for the vertex cache\n");
+};
+
+int main(int argc, char** argv) {
+	const char* fileName = "tree.obj";
+	unsigned long numOfPoints = 800;
+	searchModes searchMode = search_simd;
+	int numThreads = -1;
+	unsigned long numOfTrees = 0;
+	unsigned long long seed = 0;
+	const char* cacheDir = NULL;
+	unsigned long long cacheSize = 0;
+	const char* statsFile = NULL;
+	const char* traceFile = NULL;
+	bool optimiseVertexCache = true;
+	
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+			fileName = argv[++i];
+		} else if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc)) {
+			numOfPoints = strtoul(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc)) {
+			const char* mode = argv[++i];
+			if (strcmp(mode, "brute") == 0) {
+				searchMode = search_brute_force;
+			} else if (strcmp(mode, "grid") == 0) {
+				searchMode = search_grid;
+			} else if (strcmp(mode, "kdtree") == 0) {
+				searchMode = search_kdtree;
+			} else if (strcmp(mode, "simd") == 0) {
+				searchMode = search_simd;
+			} else {
+				usage();
+				return EXIT_FAILURE;
+			};
+		} else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) {
+			numThreads = atoi(argv[++i]);
+		} else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+			seed = strtoull(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "-c") == 0) && (i + 1 < argc)) {
+			cacheDir = argv[++i];
+		} else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc)) {
+			cacheSize = strtoull(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "-j") == 0) && (i + 1 < argc)) {
+			statsFile = argv[++i];
+		} else if ((strcmp(argv[i], "-T") == 0) && (i + 1 < argc)) {
+			traceFile = argv[++i];
+		} else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+			numOfTrees = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-u") == 0) {
+			optimiseVertexCache = false;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		};
+	};
+	
+	// our tree, by default the same as our interactive version
+	treespec spec;
+	spec.seed = seed;
+	spec.searchMode = searchMode;
+	spec.optimiseVertexCache = optimiseVertexCache;
+	spec.clouds[0].numOfPoints = numOfPoints;
+	spec.clouds[1].numOfPoints = numOfPoints * 3 / 8;
+	spec.clouds[2].numOfPoints = numOfPoints / 16;
+	
+	treecache* cache = NULL;
+	if (cacheDir != NULL) {
+		cache = new treecache(cacheDir, cacheSize * 1024 * 1024);
+	};
+	
+	if (numOfTrees > 0) {
+		// generate a forest, each tree gets its own seed
+		std::vector<treespec> specs(numOfTrees, spec);
+		for (unsigned long t = 0; t < numOfTrees; t++) {
+			specs[t].seed = seed + t;
+		};
+		
+		forestOutput output;
+		output.fileName = fileName;
+		output.numOfTrees = 0;
+		output.numOfVertices = 0;
+		output.success = true;
+		
+		int forestThreads = (numThreads > 0 ? numThreads : threadpool::numCores());
+		forest trees(forestThreads);
+		trees.setCache(cache);
+		double start = now();
+		trees.generate(specs, writeForestTree, &output);
+		double total = now() - start;
+		
+		printf("forest:   %10.1f ms, %lu trees on %d threads, %lu vertices\n", total, output.numOfTrees, forestThreads, output.numOfVertices);
+		printf("          %10.1f trees per hour\n", output.numOfTrees * 3600000.0 / total);
+		printf("memory:   %10.1f MB peak for our process\n", treestats::peakProcessMemory() / 1048576.0);
+		if (cache != NULL) {
+			printf("cache:    %lu hits, %lu misses\n", cache->hits(), cache->misses());
+			delete cache;
+		};
+		if (traceFile != NULL) {
+			writeTrace(traceFile);
+		};
+		
+		return output.success ? EXIT_SUCCESS : EXIT_FAILURE;
+	};
+	
+	double start = now();
+	double stageStart = start;
+	treemesh mesh;
+	
+	if ((cache != NULL) && cache->load(spec, mesh, numThreads >= 0)) {
+		printf("cache:    %10.1f ms, %lu vertices, %lu quads, %lu triangles\n", now() - stageStart, (unsigned long) mesh.vertices.size(), (unsigned long) mesh.treeElements.size(), (unsigned long) mesh.leafElements.size());
+		stageStart = now();
+	} else {
+		buildreport report;
+		forest::buildTree(spec, mesh, numThreads, &report);
+		printf("grow:     %10.1f ms, %lu iterations, %lu nodes\n", report.pointsTime + report.growTime, report.iterations, report.grownNodes);
+		printf("optimise: %10.1f ms, %lu nodes\n", report.optimiseTime, report.numOfNodes);
+		printf("mesh:     %10.1f ms, %lu vertices, %lu quads, %lu triangles\n", report.modelTime, (unsigned long) mesh.vertices.size(), (unsigned long) mesh.treeElements.size(), (unsigned long) mesh.leafElements.size());
+		if (spec.optimiseVertexCache) {
+			printf("acmr:     bark %.3f -> %.3f, leaves %.3f -> %.3f\n", report.cacheStats.treeBefore, report.cacheStats.treeAfter, report.cacheStats.leafBefore, report.cacheStats.leafAfter);
+		};
+		printf("memory:   %10.1f MB peak for our tree, %.1f MB peak for our process\n", report.peakMemory / 1048576.0, treestats::peakProcessMemory() / 1048576.0);
+		if (statsFile != NULL) {
+			if (!treestats::enabled()) {
+				fprintf(stderr, "Stats weren't recorded, rebuild with STATS=1\n");
+			};
+			if (!report.stats.writeJSON(statsFile)) {
+				fprintf(stderr, "Couldn't write %s\n", statsFile);
+			};
+		};
+		stageStart = now();
+		
+		if (cache != NULL) {
+			cache->store(spec, mesh, numThreads >= 0);
+			printf("store:    %10.1f ms\n", now() - stageStart);
+			stageStart = now();
+		};
+	};
+	
+	if (cache != NULL) {
+		delete cache;
+	};
+	
+	bool success = writeMesh(mesh, fileName);
+	if (success) {
+		printf("write:    %10.1f ms, %s\n", now() - stageStart, fileName);
+	} else {
+		fprintf(stderr, "Couldn't write %s\n", fileName);
+	};
+	printf("total:    %10.1f ms\n", now() - start);
+	
+	if (traceFile != NULL) {
+		writeTrace(traceFile);
+	};
+	
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+};
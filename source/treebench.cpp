@@ -0,0 +1,418 @@
+/********************************************************************
+ * Our benchmark suite
+ *
+ * Runs a fixed set of scenarios through every stage of our tree
+ * generation, plus a few micro benchmarks of our math classes, and
+ * writes the timings as JSON so results can be compared between
+ * releases. All scenarios use fixed seeds so every run generates the
+ * same trees. Build with "make bench".
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treebench.h"
+
+#define		TREEBENCH_FORMAT		1
+
+// a tree we benchmark
+class scenario {
+public:
+	const char*		name;
+	const char*		description;
+	treespec		spec;
+	unsigned long	runs;										// number of times we generate our tree, we report the fastest and the mean
+};
+
+// the timings of one stage over all runs of a scenario
+class stageresult {
+public:
+	const char*		stage;
+	unsigned long	runs;
+	double			minTime;
+	double			totalTime;
+	double			maxTime;
+	unsigned long	work;										// iterations, points or nodes depending on our stage
+	const char*		workName;
+
+	stageresult(const char* pStage, const char* pWorkName) {
+		stage = pStage;
+		runs = 0;
+		minTime = 0.0;
+		totalTime = 0.0;
+		maxTime = 0.0;
+		work = 0;
+		workName = pWorkName;
+	};
+
+	void add(double pTime, unsigned long pWork) {
+		minTime = (runs == 0 || pTime < minTime ? pTime : minTime);
+		maxTime = (runs == 0 || pTime > maxTime ? pTime : maxTime);
+		totalTime += pTime;
+		work = pWork;
+		runs++;
+	};
+};
+
+// the result of one micro benchmark
+class microresult {
+public:
+	const char*		name;
+	unsigned long	ops;
+	double			time;
+};
+
+// stops our compiler from optimising our micro benchmarks away
+static volatile float benchSink;
+
+/**
+ * pointsSpec(pNumOfPoints)
+ *
+ * Our default tree with pNumOfPoints points in its inner cloud and its outer clouds scaled to match, like treebatch -p
+ **/
+treespec pointsSpec(unsigned long pNumOfPoints) {
+	treespec spec;
+	spec.clouds[0].numOfPoints = pNumOfPoints;
+	spec.clouds[1].numOfPoints = pNumOfPoints * 3 / 8;
+	spec.clouds[2].numOfPoints = pNumOfPoints / 16;
+
+	return spec;
+};
+
+/**
+ * makeScenarios(pScenarios)
+ *
+ * Our benchmark scenarios, never change an existing scenario or results can no longer be compared, add a new one instead
+ **/
+void makeScenarios(std::vector<scenario>& pScenarios) {
+	scenario newScenario;
+
+	newScenario.name = "points_1k";
+	newScenario.description = "default tree, 1000 points in its inner cloud";
+	newScenario.spec = pointsSpec(1000);
+	newScenario.runs = 10;
+	pScenarios.push_back(newScenario);
+
+	newScenario.name = "points_10k";
+	newScenario.description = "default tree, 10000 points in its inner cloud";
+	newScenario.spec = pointsSpec(10000);
+	newScenario.runs = 3;
+	pScenarios.push_back(newScenario);
+
+	newScenario.name = "points_100k";
+	newScenario.description = "default tree, 100000 points in its inner cloud";
+	newScenario.spec = pointsSpec(100000);
+	newScenario.runs = 1;
+	pScenarios.push_back(newScenario);
+
+	newScenario.name = "points_1m";
+	newScenario.description = "default tree, 1000000 points in its inner cloud";
+	newScenario.spec = pointsSpec(1000000);
+	newScenario.runs = 1;
+	pScenarios.push_back(newScenario);
+
+	// a tall narrow column above our trunk gives long chains of nodes, every point must be within reach of our tree
+	// as it grows or doIteration never finishes
+	newScenario.name = "deep";
+	newScenario.description = "tall narrow column above our trunk, long chains of nodes";
+	newScenario.spec = treespec();
+	newScenario.spec.clouds.clear();
+	newScenario.spec.clouds.push_back(cloudspec(2000, 10.0f, 0.0f, 20.0f, 20.0f));
+	newScenario.spec.stages.resize(1);
+	newScenario.runs = 5;
+	pScenarios.push_back(newScenario);
+
+	// a wide flat cloud just above our trunk gives lots of short branches
+	newScenario.name = "bushy";
+	newScenario.description = "wide flat cloud just above our trunk, many short branches";
+	newScenario.spec = treespec();
+	newScenario.spec.clouds.clear();
+	newScenario.spec.clouds.push_back(cloudspec(20000, 150.0f, 20.0f, 0.3f, 30.0f));
+	newScenario.spec.stages.resize(1);
+	newScenario.runs = 3;
+	pScenarios.push_back(newScenario);
+
+	// small steps and no optimising gives createModel as many nodes as possible
+	newScenario.name = "model_large";
+	newScenario.description = "10000 points grown in small steps without optimising, a large createModel input";
+	newScenario.spec = pointsSpec(10000);
+	newScenario.spec.stages[0].branchSize = 0.5f;
+	newScenario.spec.stages[1].branchSize = 0.5f;
+	newScenario.spec.optimise = false;
+	newScenario.runs = 3;
+	pScenarios.push_back(newScenario);
+};
+
+/**
+ * numOfPoints(pSpec)
+ *
+ * Total number of attraction points in our spec
+ **/
+unsigned long numOfPoints(const treespec& pSpec) {
+	unsigned long total = 0;
+	for (unsigned long c = 0; c < pSpec.clouds.size(); c++) {
+		total += pSpec.clouds[c].numOfPoints;
+	};
+
+	return total;
+};
+
+/**
+ * runScenario(pScenario, pRuns, pNumThreads, pResults, pPeakMemory, pCacheStats)
+ *
+ * Generates the tree for our scenario pRuns times timing each stage, pPeakMemory is set to the most memory our tree used
+ * and pCacheStats to how well our mesh uses the vertex cache
+ **/
+void runScenario(const scenario& pScenario, unsigned long pRuns, int pNumThreads, std::vector<stageresult>& pResults, unsigned long& pPeakMemory, cachestats& pCacheStats) {
+	const treespec& spec = pScenario.spec;
+
+	pResults.clear();
+	pResults.push_back(stageresult("generateAttractionPoints", "points"));
+	pResults.push_back(stageresult("doIteration", "iterations"));
+	pResults.push_back(stageresult("optimiseNodes", "nodes"));
+	pResults.push_back(stageresult("createModel", "vertices"));
+	pResults.push_back(stageresult("total", "vertices"));
+	pPeakMemory = 0;
+
+	for (unsigned long r = 0; r < pRuns; r++) {
+		treemesh mesh;
+		buildreport report;
+		forest::buildTree(spec, mesh, pNumThreads, &report);
+
+		double total = report.pointsTime + report.growTime + report.optimiseTime + report.modelTime;
+		pResults[0].add(report.pointsTime, numOfPoints(spec));
+		pResults[1].add(report.growTime, report.iterations);
+		pResults[2].add(report.optimiseTime, report.numOfNodes);
+		pResults[3].add(report.modelTime, mesh.vertices.size());
+		pResults[4].add(total, mesh.vertices.size());
+		if (report.peakMemory > pPeakMemory) {
+			pPeakMemory = report.peakMemory;
+		};
+		pCacheStats = report.cacheStats;
+	};
+};
+
+/**
+ * runMicroBenchmarks(pResults)
+ *
+ * Our micro benchmarks, each runs a fixed number of operations on data that depends on the previous result
+ **/
+void runMicroBenchmarks(std::vector<microresult>& pResults) {
+	const unsigned long ops = 10000000;
+	microresult result;
+	double start;
+
+	// vec3::length
+	{
+		vec3 v(1.0f, 2.0f, 3.0f);
+		float total = 0.0f;
+		start = treestats::now();
+		for (unsigned long i = 0; i < ops; i++) {
+			total += v.length();
+			v.x += 0.000001f;
+		};
+		result.time = treestats::now() - start;
+		benchSink = total;
+		result.name = "vec3::length";
+		result.ops = ops;
+		pResults.push_back(result);
+	};
+
+	// vec3::normalized
+	{
+		vec3 v(1.0f, 2.0f, 3.0f);
+		vec3 total(0.0f, 0.0f, 0.0f);
+		start = treestats::now();
+		for (unsigned long i = 0; i < ops; i++) {
+			total += v.normalized();
+			v.y += 0.000001f;
+		};
+		result.time = treestats::now() - start;
+		benchSink = total.x + total.y + total.z;
+		result.name = "vec3::normalized";
+		result.ops = ops;
+		pResults.push_back(result);
+	};
+
+	// vec3 cross and dot product
+	{
+		vec3 a(1.0f, 2.0f, 3.0f);
+		vec3 b(3.0f, 1.0f, 2.0f);
+		float total = 0.0f;
+		start = treestats::now();
+		for (unsigned long i = 0; i < ops; i++) {
+			vec3 c = a * b;
+			total += c % a;
+			a.z += 0.000001f;
+		};
+		result.time = treestats::now() - start;
+		benchSink = total;
+		result.name = "vec3::cross+dot";
+		result.ops = ops;
+		pResults.push_back(result);
+	};
+
+	// mat3::rotate, as used for our slices
+	{
+		mat3 m;
+		vec3 axis(0.0f, 1.0f, 0.0f);
+		vec3 total(0.0f, 0.0f, 0.0f);
+		start = treestats::now();
+		for (unsigned long i = 0; i < ops / 10; i++) {
+			m.identity();
+			m.rotate((float) (i % 360), axis);
+			total += m * axis;
+			axis.x += 0.000001f;
+		};
+		result.time = treestats::now() - start;
+		benchSink = total.x + total.y + total.z;
+		result.name = "mat3::rotate";
+		result.ops = ops / 10;
+		pResults.push_back(result);
+	};
+
+	// mat4::operator*=
+	{
+		mat4 a;
+		mat4 b;
+		b.rotate(0.001f, 0.0f, 1.0f, 0.0f);
+		start = treestats::now();
+		for (unsigned long i = 0; i < ops / 10; i++) {
+			a *= b;
+		};
+		result.time = treestats::now() - start;
+		benchSink = (a * vec3(1.0f, 0.0f, 0.0f)).x;
+		result.name = "mat4::operator*=";
+		result.ops = ops / 10;
+		pResults.push_back(result);
+	};
+};
+
+const char* kernelName() {
+	switch (pointcloud::kernel()) {
+		case kernel_avx2: {
+			return "avx2";
+		} break;
+		case kernel_sse4: {
+			return "sse4";
+		} break;
+		default: {
+			return "scalar";
+		} break;
+	};
+};
+
+void usage() {
+	printf("Usage: treebench [options]\n");
+	printf("  -o <file>      file to write our results to as JSON (default stdout)\n");
+	printf("  -f <name>      only run scenarios whose name contains this\n");
+	printf("  -m <points>    skip scenarios with more attraction points than this\n");
+	printf("  -r <runs>      number of runs for each scenario (default depends on the scenario)\n");
+	printf("  -t <threads>   grow our trees in parallel on this many threads (0 = one per core)\n");
+	printf("  -x             skip our micro benchmarks\n");
+	printf("  -l             list our scenarios\n");
+};
+
+int main(int argc, char** argv) {
+	const char* fileName = NULL;
+	const char* filter = NULL;
+	unsigned long maxPoints = 0;
+	unsigned long runs = 0;
+	int numThreads = -1;
+	bool micro = true;
+	bool list = false;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+			fileName = argv[++i];
+		} else if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc)) {
+			filter = argv[++i];
+		} else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc)) {
+			maxPoints = strtoul(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+			runs = strtoul(argv[++i], NULL, 10);
+		} else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) {
+			numThreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-x") == 0) {
+			micro = false;
+		} else if (strcmp(argv[i], "-l") == 0) {
+			list = true;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		};
+	};
+
+	std::vector<scenario> scenarios;
+	makeScenarios(scenarios);
+
+	if (list) {
+		for (unsigned long s = 0; s < scenarios.size(); s++) {
+			printf("%-12s %8lu points  %s\n", scenarios[s].name, numOfPoints(scenarios[s].spec), scenarios[s].description);
+		};
+		return EXIT_SUCCESS;
+	};
+
+	FILE* file = stdout;
+	if (fileName != NULL) {
+		file = fopen(fileName, "w");
+		if (file == NULL) {
+			fprintf(stderr, "Couldn't write %s\n", fileName);
+			return EXIT_FAILURE;
+		};
+	};
+
+	// our progress goes to stderr so our results can go to stdout
+	fprintf(file, "{\n\t\"format\": %d,\n\t\"kernel\": \"%s\",\n\t\"threads\": %d,\n\t\"scenarios\": [", TREEBENCH_FORMAT, kernelName(), numThreads);
+	bool first = true;
+	for (unsigned long s = 0; s < scenarios.size(); s++) {
+		const scenario& bench = scenarios[s];
+		if ((filter != NULL) && (strstr(bench.name, filter) == NULL)) {
+			continue;
+		};
+		if ((maxPoints > 0) && (numOfPoints(bench.spec) > maxPoints)) {
+			continue;
+		};
+
+		std::vector<stageresult> results;
+		unsigned long peakMemory;
+		cachestats cacheStats;
+		unsigned long benchRuns = (runs > 0 ? runs : bench.runs);
+		fprintf(stderr, "%s (%lu runs)\n", bench.name, benchRuns);
+		runScenario(bench, benchRuns, numThreads, results, peakMemory, cacheStats);
+
+		fprintf(file, "%s\n\t\t{\n\t\t\t\"name\": \"%s\",\n\t\t\t\"points\": %lu,\n\t\t\t\"runs\": %lu,\n\t\t\t\"peak_bytes\": %lu,", first ? "" : ",", bench.name, numOfPoints(bench.spec), benchRuns, peakMemory);
+		fprintf(file, "\n\t\t\t\"acmr\": { \"bark_before\": %.3f, \"bark_after\": %.3f, \"leaves_before\": %.3f, \"leaves_after\": %.3f },\n\t\t\t\"stages\": [", cacheStats.treeBefore, cacheStats.treeAfter, cacheStats.leafBefore, cacheStats.leafAfter);
+		for (unsigned long r = 0; r < results.size(); r++) {
+			const stageresult& result = results[r];
+			double mean = result.totalTime / result.runs;
+			fprintf(stderr, "  %-26s %10.3f ms min %10.3f ms mean, %lu %s\n", result.stage, result.minTime, mean, result.work, result.workName);
+			fprintf(file, "%s\n\t\t\t\t{ \"stage\": \"%s\", \"min_ms\": %.3f, \"mean_ms\": %.3f, \"max_ms\": %.3f, \"%s\": %lu }", r > 0 ? "," : "", result.stage, result.minTime, mean, result.maxTime, result.workName, result.work);
+		};
+		fprintf(stderr, "  %-26s %10.1f MB peak\n", "memory", peakMemory / 1048576.0);
+		fprintf(stderr, "  %-26s bark %.3f -> %.3f, leaves %.3f -> %.3f\n", "acmr", cacheStats.treeBefore, cacheStats.treeAfter, cacheStats.leafBefore, cacheStats.leafAfter);
+		fprintf(file, "\n\t\t\t]\n\t\t}");
+		first = false;
+	};
+	fprintf(file, "\n\t],\n\t\"micro\": [");
+
+	if (micro) {
+		std::vector<microresult> results;
+		fprintf(stderr, "micro benchmarks\n");
+		runMicroBenchmarks(results);
+
+		for (unsigned long r = 0; r < results.size(); r++) {
+			const microresult& result = results[r];
+			double nsPerOp = result.time * 1000000.0 / result.ops;
+			fprintf(stderr, "  %-26s %10.3f ns per op\n", result.name, nsPerOp);
+			fprintf(file, "%s\n\t\t{ \"name\": \"%s\", \"ops\": %lu, \"ms\": %.3f, \"ns_per_op\": %.3f }", r > 0 ? "," : "", result.name, result.ops, result.time, nsPerOp);
+		};
+	};
+	fprintf(file, "\n\t],\n\t\"peak_process_bytes\": %lu\n}\n", treestats::peakProcessMemory());
+
+	bool success = (ferror(file) == 0);
+	if ((file != stdout) && (fclose(file) != 0)) {
+		success = false;
+	};
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+};
@@ -0,0 +1,1808 @@
+/********************************************************************
+ * treebuilder contains the logic to generate our tree
+ * 
+ * Implementation based on the "Space Colonization Algorithm" by
+ * Adam Runions, Brendan Lane, and Przemyslaw Prusinkiewicz
+ *
+ * treebuilder doesn't depend on OpenGL so we can also use it to
+ * generate trees from the command line, see treelogic for rendering.
+ * 
+ * By Bastiaan Olij - 2014
+********************************************************************/
+
+#include "treebuilder.h"
+
+/////////////////////////////////////////////////////////////////////
+// class for a slice
+/////////////////////////////////////////////////////////////////////
+
+slice::slice() {
+	for (int i = 0; i < 5; i++) {
+		p[i] = 0;
+	};
+};
+
+slice::slice(const slice& pCopy) {
+	for (int i = 0; i < 5; i++) {
+		p[i] = pCopy.p[i];
+	};	
+};
+
+slice& slice::operator=(const slice& pCopy) {
+	for (int i = 0; i < 5; i++) {
+		p[i] = pCopy.p[i];
+	};
+	
+	return (*this);
+};
+
+/////////////////////////////////////////////////////////////////////
+// treebuilder
+//
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * treebuilder()
+ * 
+ * constructor for our treebuilder, we start off with just our root vertex
+ **/
+treebuilder::treebuilder() {
+	// set some defaults
+	setSeed(0);
+	mLastNumOfVerts	= 1;
+	mPeakMemory = 0;
+	mLazyChildCount = false;
+	mChildCountDirty = false;
+	mBatchOptimise = false;
+	mOptimiseVertexCache = false;
+	mShortIndices = false;
+	mSearchMode = search_brute_force;
+	mSearchRadius = FLT_MAX;
+	mPointCloudLoaded = false;
+	mParallel = false;
+	mNumThreads = 0;
+	mThreadPool = NULL;
+	mUpdateBuffers = true;
+	
+	// add our root vertex
+	addVertex(vec3(0.0, 0.0, 0.0)); // our tree "root"
+	
+	// tree generation info
+	mMinRadius = 0.4f;
+	mRadiusFactor = 1.0f / 400.0f;
+	mLeafSize.x = 20.0f;
+	mLeafSize.y = 30.0f;
+};
+
+treebuilder::~treebuilder() {
+	// stop our worker threads
+	if (mThreadPool != NULL) {
+		delete mThreadPool;
+		mThreadPool = NULL;
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long long treebuilder::seed() {
+	return mSeed;
+};
+
+/**
+ * setSeed(pSeed)
+ *
+ * Sets the seed for our random numbers, the same seed gives the same tree. Our streams start over.
+ **/
+void treebuilder::setSeed(unsigned long long pSeed) {
+	mSeed = pSeed;
+	mPointsRandom.reset(pSeed, stream_attraction_points);
+	mLeavesRandom.reset(pSeed, stream_leaves);
+};
+
+float treebuilder::minRadius() {
+	return mMinRadius;
+};
+
+void treebuilder::setMinRadius(float pRadius) {
+	mMinRadius = pRadius;
+};
+
+float treebuilder::radiusFactor() {
+	return mRadiusFactor;
+};
+
+void treebuilder::setRadiusFactor(float pFactor) {
+	mRadiusFactor = pFactor;
+};
+
+vec2 treebuilder::leafSize() {
+	return mLeafSize;
+};
+
+void treebuilder::setLeafSize(vec2 pSize) {
+	mLeafSize = pSize;
+};
+
+searchModes treebuilder::searchMode() {
+	return mSearchMode;
+};
+
+void treebuilder::setSearchMode(searchModes pMode) {
+	mSearchMode = pMode;
+};
+
+bool treebuilder::parallel() {
+	return mParallel;
+};
+
+void treebuilder::setParallel(bool pParallel) {
+	mParallel = pParallel;
+};
+
+int treebuilder::numThreads() {
+	return mNumThreads;
+};
+
+void treebuilder::setNumThreads(int pNumThreads) {
+	if (mNumThreads != pNumThreads) {
+		mNumThreads = pNumThreads;
+		
+		// we'll create a new pool with the right number of threads when we need it
+		if (mThreadPool != NULL) {
+			delete mThreadPool;
+			mThreadPool = NULL;
+		};
+	};
+};
+
+bool treebuilder::lazyChildCount() {
+	return mLazyChildCount;
+};
+
+void treebuilder::setLazyChildCount(bool pLazy) {
+	if (!pLazy) {
+		// make sure our counts are correct before growBranch starts updating them again
+		updateChildCounts();
+	};
+	
+	mLazyChildCount = pLazy;
+};
+
+bool treebuilder::batchOptimise() {
+	return mBatchOptimise;
+};
+
+void treebuilder::setBatchOptimise(bool pBatch) {
+	mBatchOptimise = pBatch;
+};
+
+bool treebuilder::optimiseVertexCache() {
+	return mOptimiseVertexCache;
+};
+
+/**
+ * setOptimiseVertexCache(pOptimise)
+ *
+ * If pOptimise is true createModel reorders our elements and vertices so our GPU can reuse more of the vertices
+ * it has already transformed, see cacheStats() for how well that worked. Our mesh looks exactly the same.
+ **/
+void treebuilder::setOptimiseVertexCache(bool pOptimise) {
+	mOptimiseVertexCache = pOptimise;
+};
+
+bool treebuilder::shortIndices() {
+	return mShortIndices;
+};
+
+/**
+ * setShortIndices(pShort)
+ *
+ * If pShort is true createModel also writes our elements as 16 bit indices into treeIndices() and leafIndices(),
+ * split into chunks if our mesh has more than 65536 vertices. If our elements can't be chunked sensibly these stay
+ * empty and our 32 bit elements should be used. Call this before createModel.
+ **/
+void treebuilder::setShortIndices(bool pShort) {
+	mShortIndices = pShort;
+};
+
+vertexFormats treebuilder::vertexFormat() {
+	return mPackedVertices.format();
+};
+
+/**
+ * setVertexFormat(pFormat)
+ *
+ * If pFormat isn't vertex_planar createModel also writes our mesh vertices into packedVertices() in that format,
+ * call this before createModel
+ **/
+void treebuilder::setVertexFormat(vertexFormats pFormat) {
+	mPackedVertices.setFormat(pFormat);
+};
+
+const std::vector<vec3>& treebuilder::vertices() const {
+	return mVertices;
+};
+
+const std::vector<vec3>& treebuilder::normals() const {
+	return mNormals;
+};
+
+const std::vector<vec2>& treebuilder::texCoords() const {
+	return mTexCoords;
+};
+
+const std::vector<quad>& treebuilder::treeElements() const {
+	return mTreeElements;
+};
+
+const std::vector<triangle>& treebuilder::leafElements() const {
+	return mLeafElements;
+};
+
+const packedvertices& treebuilder::packedVertices() const {
+	return mPackedVertices;
+};
+
+const indexbuffer& treebuilder::treeIndices() const {
+	return mTreeIndices;
+};
+
+const indexbuffer& treebuilder::leafIndices() const {
+	return mLeafIndices;
+};
+
+unsigned long treebuilder::numOfNodes() const {
+	return mNodes.size();
+};
+
+/**
+ * memoryUsed()
+ *
+ * Returns the number of bytes our arrays have allocated right now
+ **/
+unsigned long treebuilder::memoryUsed() const {
+	unsigned long bytes = 0;
+	
+	bytes += mAttractionPoints.capacity() * sizeof(attractionPoint);
+	bytes += (mVertices.capacity() + mNormals.capacity() + mSkeletonVertices.capacity()) * sizeof(vec3);
+	bytes += mTexCoords.capacity() * sizeof(vec2);
+	bytes += (mNodes.capacity() + mSkeletonNodes.capacity()) * sizeof(treenode);
+	bytes += mVertexNodes.capacity() * sizeof(long);
+	bytes += (mChildStart.capacity() + mChildNodes.capacity()) * sizeof(unsigned long);
+	bytes += mSlices.capacity() * sizeof(slice);
+	bytes += mTreeElements.capacity() * sizeof(quad);
+	bytes += mLeafElements.capacity() * sizeof(triangle);
+	bytes += mSubtreeCounts.capacity() * sizeof(meshCursor);
+	bytes += mPackedVertices.memoryUsed();
+	bytes += mTreeIndices.memoryUsed() + mLeafIndices.memoryUsed();
+	bytes += mVertexTree.memoryUsed();
+	bytes += mPointCloud.memoryUsed();
+	bytes += mPointGrid.memoryUsed();
+	for (unsigned long b = 0; b < mIterationBuffers.size(); b++) {
+		const iterationBuffers& buffers = mIterationBuffers[b];
+		bytes += (buffers.numOfAPoints.capacity() + buffers.lastClosest.capacity() + buffers.touched.capacity()) * sizeof(unsigned long);
+		bytes += buffers.directions.capacity() * sizeof(long long);
+		bytes += buffers.stack.capacity() * sizeof(long);
+	};
+	
+	return bytes;
+};
+
+/**
+ * peakMemory()
+ *
+ * Returns the most memory we've used at any point while growing our tree and building our model, this includes
+ * the temporary buffers of doIteration and createModel
+ **/
+unsigned long treebuilder::peakMemory() const {
+	return mPeakMemory;
+};
+
+const treestats& treebuilder::stats() const {
+	return mStats;
+};
+
+/**
+ * cacheStats()
+ *
+ * Returns the ACMR of the mesh createModel built before and after we reordered it, only set if optimiseVertexCache() is true
+ **/
+const cachestats& treebuilder::cacheStats() const {
+	return mCacheStats;
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * addVertex(pVertex)
+ *
+ * Adds a vertex to our vertex array (and initializes a normal and texture coord)
+ **/
+unsigned long treebuilder::addVertex(const vec3& pVertex) {
+	mVertices.push_back(pVertex);
+	mNormals.push_back(pVertex.normalized()); // just for now, this will be updates
+	mTexCoords.push_back(vec2(0.0f, 0.0f));
+	mVertexNodes.push_back(-1); // growBranch will set this if it adds a node for this vertex
+	
+	// make sure we update our buffers
+	mUpdateBuffers = true;
+
+	return mVertices.size()-1;
+};
+
+/**
+ * updatePeakMemory(pTemporary)
+ *
+ * Checks if we're using more memory than we've used so far, call this where our memory use peaks
+ *
+ * pTemporary	- bytes used by temporary buffers that memoryUsed() doesn't know about
+ **/
+void treebuilder::updatePeakMemory(unsigned long pTemporary) {
+	unsigned long bytes = memoryUsed() + pTemporary;
+	if (bytes > mPeakMemory) {
+		mPeakMemory = bytes;
+	};
+};
+
+/**
+ * remVertex(pIndex)
+ *
+ * Removes the vertex at index pIndex and updates related arrays
+ **/
+void treebuilder::remVertex(unsigned long pIndex) {
+	mVertices.erase(mVertices.begin() + pIndex);
+	mNormals.erase(mNormals.begin() + pIndex);
+	mTexCoords.erase(mTexCoords.begin() + pIndex);
+	mVertexNodes.erase(mVertexNodes.begin() + pIndex);
+	
+	// our vertex indices are changing, our k-d tree will need to be rebuild
+	mVertexTree.clear();
+	
+	// adjust our other nodes
+	for (unsigned long n = 0; n < mNodes.size(); n++) {
+		if (mNodes[n].a > pIndex) mNodes[n].a--;
+		if (mNodes[n].b > pIndex) mNodes[n].b--;
+	};
+	
+	// adjust our elements
+	for (unsigned long e = 0; e < mTreeElements.size(); e++) {
+		for (int i = 0; i < 4; i++) {
+			if (mTreeElements[e].v[i] > pIndex) mTreeElements[e].v[i]--;
+		};
+	};
+
+	for (unsigned long e = 0; e < mLeafElements.size(); e++) {
+		for (int i = 0; i < 3; i++) {
+			if (mLeafElements[e].v[i] > pIndex) mLeafElements[e].v[i]--;
+		};
+	};
+	
+	// make sure we update our buffers
+	mUpdateBuffers = true;
+};
+
+/**
+ * remVertices(pRemove)
+ *
+ * Removes all vertices marked in pRemove in one go, the remaining vertices keep their order.
+ * Gives the same result as calling remVertex for each of them but we only update our nodes and elements once.
+ * Nodes and elements must not use any of the vertices we remove.
+ *
+ * pRemove	- true for each vertex we want to remove
+ **/
+void treebuilder::remVertices(const std::vector<bool>& pRemove) {
+	unsigned long numVerts = mVertices.size();
+	std::vector<unsigned long> newIndex(numVerts);
+	unsigned long i = 0;
+	
+	for (unsigned long v = 0; v < numVerts; v++) {
+		newIndex[v] = i;
+		if (!pRemove[v]) {
+			mVertices[i] = mVertices[v];
+			mNormals[i] = mNormals[v];
+			mTexCoords[i] = mTexCoords[v];
+			mVertexNodes[i] = mVertexNodes[v];
+			i++;
+		};
+	};
+	
+	mVertices.resize(i);
+	mNormals.resize(i);
+	mTexCoords.resize(i);
+	mVertexNodes.resize(i);
+	
+	// our vertex indices are changing, our k-d tree will need to be rebuild
+	mVertexTree.clear();
+	
+	// adjust our nodes
+	for (unsigned long n = 0; n < mNodes.size(); n++) {
+		mNodes[n].a = newIndex[mNodes[n].a];
+		mNodes[n].b = newIndex[mNodes[n].b];
+	};
+	
+	// adjust our elements
+	for (unsigned long e = 0; e < mTreeElements.size(); e++) {
+		for (int j = 0; j < 4; j++) {
+			mTreeElements[e].v[j] = newIndex[mTreeElements[e].v[j]];
+		};
+	};
+
+	for (unsigned long e = 0; e < mLeafElements.size(); e++) {
+		for (int j = 0; j < 3; j++) {
+			mLeafElements[e].v[j] = newIndex[mLeafElements[e].v[j]];
+		};
+	};
+	
+	// make sure we update our buffers
+	mUpdateBuffers = true;
+};
+
+/**
+ * updateChildCounts()
+ *
+ * Recounts the childcount of all our nodes if growBranch left them out of date.
+ * Nodes are always added after their parent so we can do this in a single pass from back to front.
+ **/
+void treebuilder::updateChildCounts() {
+	if (!mChildCountDirty) {
+		return;
+	};
+	
+	for (unsigned long n = 0; n < mNodes.size(); n++) {
+		mNodes[n].childcount = 0;
+	};
+	
+	for (unsigned long n = mNodes.size(); n > 0; n--) {
+		const treenode& node = mNodes[n - 1];
+		if (node.parent != -1) {
+			mNodes[node.parent].childcount += node.childcount + 1;
+		};
+	};
+	
+	mChildCountDirty = false;
+};
+
+/**
+ * buildChildIndex()
+ *
+ * Builds a compressed index of the children of each node so we don't have to scan all our nodes to find them.
+ * Children are stored in order of their index, exactly as if we had scanned our nodes. Our root nodes
+ * (parent -1) are stored in slot 0, the children of node n in slot n+1.
+ **/
+void treebuilder::buildChildIndex() {
+	unsigned long numNodes = mNodes.size();
+	
+	// count the children in each slot, offset by one so we can turn our counts into start positions
+	mChildStart.assign(numNodes + 2, 0);
+	for (unsigned long n = 0; n < numNodes; n++) {
+		mChildStart[mNodes[n].parent + 2]++;
+	};
+	for (unsigned long n = 1; n < numNodes + 2; n++) {
+		mChildStart[n] += mChildStart[n - 1];
+	};
+	
+	// now place our children, this moves each start position on to the start of the next slot
+	mChildNodes.resize(numNodes);
+	for (unsigned long n = 0; n < numNodes; n++) {
+		mChildNodes[mChildStart[mNodes[n].parent + 1]++] = n;
+	};
+	
+	// and shift our start positions back
+	for (unsigned long n = numNodes + 1; n > 0; n--) {
+		mChildStart[n] = mChildStart[n - 1];
+	};
+	mChildStart[0] = 0;
+};
+
+/**
+ * findClosestBruteForce(pDistances, pFrom, pTo, pCatchUp)
+ *
+ * Updates the closest vertice of attraction points pFrom to pTo-1 by testing them against all new vertices.
+ * Ties are broken on the lowest vertex index so we always end up with the same closest vertice.
+ *
+ * pDistances	- distance from each attraction point to its closest vertice, updated as we find closer vertices
+ * pFrom		- first attraction point to update
+ * pTo			- attraction point after the last one to update
+ * pCatchUp		- if true an earlier search only looked within a radius and we retest all vertices it may have skipped
+ **/
+void treebuilder::findClosestBruteForce(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, bool pCatchUp) {
+	for (unsigned long i = pFrom; i < pTo; i++) {
+		attractionPoint& point = mAttractionPoints[i];
+		unsigned long firstVert = (pCatchUp ? point.firstVertice : mLastNumOfVerts);
+		
+		TREES_STATS_ADD(mStats, counter_distance_evaluations, mVertices.size() > firstVert ? mVertices.size() - firstVert : 0);
+		for (unsigned long v = firstVert; v < mVertices.size(); v++) {
+			vec3 delta = mVertices[v] - point.position;
+			float distance = delta.length();
+			if ((distance < pDistances[i]) || ((distance == pDistances[i]) && (v < point.closestVertice))) {
+				// this one is now our closest
+				point.closestVertice = v;
+				pDistances[i] = distance;
+			};
+		};
+	};
+};
+
+/**
+ * findClosestUsingGrid(pDistances, pRadius, pCatchUp)
+ *
+ * Same as findClosestBruteForce but we place our attraction points in a grid so each new vertex
+ * only tests the attraction points within pRadius. Points further away than pRadius may keep a
+ * closest vertice that isn't their true closest but as they are out of reach that doesn't change our tree.
+ *
+ * pDistances	- distance from each attraction point to its closest vertice, updated as we find closer vertices
+ * pRadius		- radius within which our closest vertices must be exact
+ * pCatchUp		- if true an earlier search used a smaller radius and we retest all vertices it may have skipped
+ **/
+void treebuilder::findClosestUsingGrid(std::vector<float>& pDistances, float pRadius, bool pCatchUp) {
+	std::vector<unsigned long> found;
+	
+	mPointGrid.build(mAttractionPoints, pRadius);
+	for (unsigned long v = (pCatchUp ? 0 : mLastNumOfVerts); v < mVertices.size(); v++) {
+		const vec3& vertex = mVertices[v];
+		
+		mPointGrid.findNear(vertex, found);
+#ifdef TREES_STATS
+		unsigned long tested = 0;
+#endif
+		for (unsigned long f = 0; f < found.size(); f++) {
+			unsigned long i = found[f];
+			attractionPoint& point = mAttractionPoints[i];
+			
+			// vertices that existed before our point was added are never considered
+			if (v >= point.firstVertice) {
+				vec3 delta = vertex - point.position;
+				float distance = delta.length();
+#ifdef TREES_STATS
+				tested++;
+#endif
+				if ((distance < pDistances[i]) || ((distance == pDistances[i]) && (v < point.closestVertice))) {
+					// this one is now our closest
+					point.closestVertice = v;
+					pDistances[i] = distance;
+				};
+			};
+		};
+		TREES_STATS_ADD(mStats, counter_distance_evaluations, tested);
+	};
+};
+
+/**
+ * findClosestUsingTree(pDistances, pFrom, pTo, pRadius, pCatchUp, pStack)
+ *
+ * Same as findClosestBruteForce but we search our k-d tree, which must be up to date with our vertices.
+ * Like findClosestUsingGrid we only make sure our closest vertices are exact within pRadius.
+ * Subtrees without new vertices are skipped unless we need to catch up on an earlier smaller radius.
+ *
+ * pDistances	- distance from each attraction point to its closest vertice, updated as we find closer vertices
+ * pFrom		- first attraction point to update
+ * pTo			- attraction point after the last one to update
+ * pRadius		- radius within which our closest vertices must be exact
+ * pCatchUp		- if true an earlier search used a smaller radius and we retest all vertices it may have skipped
+ * pStack		- scratch buffer for searching our k-d tree
+ **/
+void treebuilder::findClosestUsingTree(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, float pRadius, bool pCatchUp, std::vector<long>& pStack) {
+	for (unsigned long i = pFrom; i < pTo; i++) {
+		attractionPoint& point = mAttractionPoints[i];
+		unsigned long firstVert = (pCatchUp ? point.firstVertice : mLastNumOfVerts);
+		
+#ifdef TREES_STATS
+		TREES_STATS_ADD(mStats, counter_distance_evaluations, mVertexTree.findClosest(point.position, firstVert, point.closestVertice, pDistances[i], pRadius, pStack));
+#else
+		mVertexTree.findClosest(point.position, firstVert, point.closestVertice, pDistances[i], pRadius, pStack);
+#endif
+	};
+};
+
+/**
+ * findClosestUsingSimd(pDistances, pFrom, pTo, pCatchUp)
+ *
+ * Same as findClosestBruteForce but we test our point cloud using the SSE4/AVX2 kernel our CPU supports.
+ * Our kernels give the same result as vec3::length so our tree is the same as with brute force.
+ * Catching up requires checking which vertices each point may be tested against so we leave that to findClosestBruteForce.
+ **/
+void treebuilder::findClosestUsingSimd(std::vector<float>& pDistances, unsigned long pFrom, unsigned long pTo, bool pCatchUp) {
+	unsigned long i;
+	
+	if (pCatchUp) {
+		findClosestBruteForce(pDistances, pFrom, pTo, true);
+		for (i = pFrom; i < pTo; i++) {
+			mPointCloud.closest[i] = mAttractionPoints[i].closestVertice;
+		};
+	} else {
+		for (i = pFrom; i < pTo; i++) {
+			mPointCloud.distance[i] = pDistances[i];
+		};
+		
+		mPointCloud.findClosest(mVertices, mLastNumOfVerts, pFrom, pTo);
+		TREES_STATS_ADD(mStats, counter_distance_evaluations, (unsigned long long) (pTo - pFrom) * (mVertices.size() - mLastNumOfVerts));
+		
+		for (i = pFrom; i < pTo; i++) {
+			pDistances[i] = mPointCloud.distance[i];
+			mAttractionPoints[i].closestVertice = mPointCloud.closest[i];
+		};
+	};
+};
+
+/**
+ * runIterationJob(pData, pJob, pWorker)
+ *
+ * Runs one block of attraction points for countPointsInParallel, we find the closest vertice for each point
+ * (unless we're using our grid, that has already been done) and count each point into our workers buffers.
+ **/
+#define		ITERATION_BLOCK_SIZE	1024
+#define		FIXED_POINT_SCALE		4294967296.0
+
+void treebuilder::runIterationJob(void* pData, unsigned long pJob, int pWorker) {
+	TREES_TRACE_SCOPE("iterationJob");
+	iterationJob* job = (iterationJob*) pData;
+	treebuilder* tree = job->tree;
+	std::vector<float>& distances = *job->distances;
+	iterationBuffers& buffers = (*job->buffers)[pWorker];
+	unsigned long from = pJob * ITERATION_BLOCK_SIZE;
+	unsigned long to = from + ITERATION_BLOCK_SIZE;
+	if (to > distances.size()) {
+		to = distances.size();
+	};
+	
+	if (tree->mSearchMode == search_kdtree) {
+		tree->findClosestUsingTree(distances, from, to, job->searchRadius, job->catchUp, buffers.stack);
+	} else if (tree->mSearchMode == search_simd) {
+		tree->findClosestUsingSimd(distances, from, to, job->catchUp);
+	} else if (tree->mSearchMode == search_brute_force) {
+		tree->findClosestBruteForce(distances, from, to, job->catchUp);
+	};
+	
+	for (unsigned long p = from; p < to; p++) {
+		if (distances[p] < job->cutOffDistance) {
+			// we're done with this one, we'll remove it once we're done
+			(*job->reached)[p] = 1;
+		} else if (distances[p] < job->maxDistance) {
+			// count our vertice, we add our direction in fixed point so the order in which we add them up doesn't matter
+			unsigned long closest = tree->mAttractionPoints[p].closestVertice;
+			vec3 norm = tree->mAttractionPoints[p].position - tree->mVertices[closest];
+			norm = norm.normalized();
+			
+			if (buffers.numOfAPoints[closest] == 0) {
+				buffers.touched.push_back(closest);
+			};
+			buffers.numOfAPoints[closest]++;
+			buffers.directions[closest * 3] += (long long) (norm.x * FIXED_POINT_SCALE);
+			buffers.directions[closest * 3 + 1] += (long long) (norm.y * FIXED_POINT_SCALE);
+			buffers.directions[closest * 3 + 2] += (long long) (norm.z * FIXED_POINT_SCALE);
+			if (p > buffers.lastClosest[closest]) {
+				buffers.lastClosest[closest] = p;
+			};
+		};
+	};
+};
+
+/**
+ * countPointsInParallel(pDistances, pMaxDistance, pCutOffDistance, pSearchRadius, pCatchUp, pNumOfAPoints, pDirections, pLastClosest, pReached)
+ *
+ * Parallel version of finding the closest vertice for each attraction point and counting them towards it.
+ * Our attraction points are split into blocks that are handed out to our workers, each worker has its own
+ * buffers which we add together afterwards. Our buffers are kept between iterations and we only add up and
+ * clear the vertices each worker touched, so we don't go over every vertice for every thread. As our directions are added up in fixed point and we keep the
+ * highest point index our result is the same no matter how many threads we use. It differs slightly from the
+ * float sums of our serial version, so trees grown in parallel are not quite the same as trees grown serially.
+ * Points that we've reached are marked in pReached but not removed, pLastClosest indexes the points as they are now.
+ **/
+void treebuilder::countPointsInParallel(std::vector<float>& pDistances, float pMaxDistance, float pCutOffDistance, float pSearchRadius, bool pCatchUp, std::vector<float>& pNumOfAPoints, std::vector<vec3>& pDirections, std::vector<unsigned long>& pLastClosest, std::vector<unsigned char>& pReached) {
+	unsigned long numVerts = pNumOfAPoints.size();
+	unsigned long numPoints = pDistances.size();
+	
+	if (mThreadPool == NULL) {
+		mThreadPool = new threadpool(mNumThreads);
+	};
+	
+	// make room for our new vertices in our workers buffers, anything already there was cleared after our last iteration
+	std::vector<iterationBuffers>& buffers = mIterationBuffers;
+	buffers.resize(mThreadPool->numThreads());
+	for (unsigned long b = 0; b < buffers.size(); b++) {
+		buffers[b].numOfAPoints.resize(numVerts, 0);
+		buffers[b].directions.resize(numVerts * 3, 0);
+		buffers[b].lastClosest.resize(numVerts, 0);
+		buffers[b].touched.clear();
+	};
+	pReached.assign(numPoints, 0);
+	
+	iterationJob job;
+	job.tree = this;
+	job.maxDistance = pMaxDistance;
+	job.cutOffDistance = pCutOffDistance;
+	job.searchRadius = pSearchRadius;
+	job.catchUp = pCatchUp;
+	job.distances = &pDistances;
+	job.reached = &pReached;
+	job.buffers = &buffers;
+	mThreadPool->run(runIterationJob, &job, (numPoints + ITERATION_BLOCK_SIZE - 1) / ITERATION_BLOCK_SIZE);
+	
+	// add the vertices our other workers touched into our first workers buffers, clearing them as we go
+	iterationBuffers& total = buffers[0];
+	for (unsigned long b = 1; b < buffers.size(); b++) {
+		iterationBuffers& worker = buffers[b];
+		for (unsigned long t = 0; t < worker.touched.size(); t++) {
+			unsigned long v = worker.touched[t];
+			if (total.numOfAPoints[v] == 0) {
+				total.touched.push_back(v);
+			};
+			total.numOfAPoints[v] += worker.numOfAPoints[v];
+			total.directions[v * 3] += worker.directions[v * 3];
+			total.directions[v * 3 + 1] += worker.directions[v * 3 + 1];
+			total.directions[v * 3 + 2] += worker.directions[v * 3 + 2];
+			if (worker.lastClosest[v] > total.lastClosest[v]) {
+				total.lastClosest[v] = worker.lastClosest[v];
+			};
+			
+			worker.numOfAPoints[v] = 0;
+			worker.directions[v * 3] = 0;
+			worker.directions[v * 3 + 1] = 0;
+			worker.directions[v * 3 + 2] = 0;
+			worker.lastClosest[v] = 0;
+		};
+		worker.touched.clear();
+	};
+	
+	// and hand out our totals
+	for (unsigned long t = 0; t < total.touched.size(); t++) {
+		unsigned long v = total.touched[t];
+		pNumOfAPoints[v] = total.numOfAPoints[v];
+		pDirections[v] = vec3(total.directions[v * 3] / FIXED_POINT_SCALE, total.directions[v * 3 + 1] / FIXED_POINT_SCALE, total.directions[v * 3 + 2] / FIXED_POINT_SCALE);
+		pLastClosest[v] = total.lastClosest[v];
+		
+		total.numOfAPoints[v] = 0;
+		total.directions[v * 3] = 0;
+		total.directions[v * 3 + 1] = 0;
+		total.directions[v * 3 + 2] = 0;
+		total.lastClosest[v] = 0;
+	};
+	total.touched.clear();
+};
+
+/////////////////////////////////////////////////////////////////////
+// tree generation code
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * growBrach(pFromVertex, pTo)
+ *
+ * This method will grow a branch from a given vertex
+ *
+ * pFromVertex - index of vertex to grow from
+ * pTo         - location of new vertex to branch to
+ *
+ **/
+unsigned long treebuilder::growBranch(unsigned long pFromVertex, vec3 pTo) {
+	// Find our parent, this is the node that ends in the vertex we're growing from
+	int	parent = mVertexNodes[pFromVertex];
+	
+	if (parent != -1) {
+		// check our vector from our parent
+		vec3 parentVector = mVertices[mNodes[parent].b] - mVertices[mNodes[parent].a];
+		parentVector = parentVector.normalized();
+		
+		vec3 toVector = pTo - mVertices[mNodes[parent].b];
+		toVector = toVector.normalized();
+		
+		// check if we're backtracking, this can happen if we're "trapped" between two equal distanced but opposite attraction points
+		float dot = parentVector % toVector;
+		if (dot < -0.5f) {
+			// use a cross product of the two vectors 
+			pTo = mVertices[mNodes[parent].b] + (parentVector * toVector);
+		};		
+	};
+	
+	// add our new vertice
+	addVertex(pTo);
+	
+	// add our node
+	mNodes.push_back(treenode(pFromVertex, mVertices.size()-1, parent));
+	mVertexNodes[mVertices.size()-1] = mNodes.size()-1;
+	
+	// now update our count
+	if (mLazyChildCount) {
+		mChildCountDirty = true;
+	} else {
+		while (parent != -1) {
+			mNodes[parent].childcount++;
+			parent = mNodes[parent].parent;
+		};
+	};
+	
+	return mVertices.size()-1;
+};
+
+/**
+ * generateAttractionPoints(pCount, pNumOfPoints, pOuterRadius, pInnerRadius, pAspect, pOffsetY)
+ * 
+ * This method generates the attaction points for our tree. 
+ * At this moment we've only got a single very simple generation of points based on a stretched hemisphere filled with random points.
+ * The shape of our point cloud very much determines the look of our tree. 
+ * Adding more complexity to this algorithm to steer the shape of the point cloud will become a target later on.
+ *
+ * pNumOfPoints - Number of attraction points (N)
+ * pOuterRadius - Outer size of our point cloud
+ * pInnerRadius - Inner size of our point cloud
+ * pAspect      - Aspect ratio between height and width
+ * pOffsetY     - Y offset
+ * pClear    	- Clears our attraction points first
+ **/
+void treebuilder::generateAttractionPoints(unsigned long pNumOfPoints, float pOuterRadius, float pInnerRadius, float pAspect, float pOffsetY, bool pClear) {
+	if (pClear) {
+		// Clear any existing points (shouldn't be any..)
+		mAttractionPoints.clear();		
+	};
+	
+	// our point cloud needs to be reloaded
+	mPointCloudLoaded = false;
+	
+	// Add random attraction points until we reached our goal
+	for (unsigned long i = 0; i < pNumOfPoints; i++) {
+		vec3 point;
+		
+		// random normalized vector for half a hemisphere
+		point.x = mPointsRandom.randf();
+		point.y = mPointsRandom.randf(0.0f, 1.0f);
+		point.z = mPointsRandom.randf();		
+		point = point.normalized();
+		
+		// Scale it up to a random radius and stretch if needed
+		point *= ((pOuterRadius - pInnerRadius) * mPointsRandom.randf(0.0f, 1.0f)) + pInnerRadius;
+		point.y *= pAspect;
+		point.y += pOffsetY;
+		
+		// and add it to our buffer, it will only be tested against vertices added from now on
+		attractionPoint newPoint(point);
+		newPoint.closestVertice = 0;
+		newPoint.firstVertice = mLastNumOfVerts;
+		mAttractionPoints.push_back(newPoint);
+	};
+};
+
+/**
+ * doIteration(pCutOffDistance, pBranchSize)
+ * 
+ * This method performs one iteration of our tree generation logic and returns true if changes have been made.
+ * Basically you should repeatidly call this method until it returns false
+ * 
+ * pMaxDistance    - maximum distance between attraction point and vertice for it to be considered (must be > pInnerRadius) (dk)
+ * pBranchSize     - size with which we grow a branch (D)
+ * pCutOffDistance - once the closest distance to an attraction point and a vertice becomes less then this we remove the attraction point (di, must be a multiple of pBranchSize)
+ * pBias           - vector to add to simulate the effect the direction of growth
+ **/
+bool treebuilder::doIteration(float pMaxDistance, float pBranchSize, float pCutOffDistance, vec3 pBias) {
+	unsigned long numVerts = mVertices.size(); // need to know the number of vertices at the start of our process
+	unsigned long i, p, v;
+	std::vector<float> numOfAPoints;
+	std::vector<vec3> directions;
+	std::vector<unsigned long> lastClosest;
+	std::vector<float> distances;
+	std::vector<unsigned char> reached;
+	
+	TREES_TRACE_SCOPE("doIteration");
+	TREES_STATS_BEGIN_ITERATION(mStats);
+	TREES_STATS_ADD(mStats, counter_points_examined, mAttractionPoints.size());
+	
+	// init our temporary buffers
+	numOfAPoints.assign(numVerts, 0.0);
+	directions.assign(numVerts, vec3(0.0f, 0.0f, 0.0f));
+	lastClosest.assign(numVerts, 0);
+	
+	// start with our current distance for each attraction point
+	distances.resize(mAttractionPoints.size());
+	for (i = 0; i < mAttractionPoints.size(); i++) {
+		vec3 delta = mVertices[mAttractionPoints[i].closestVertice] - mAttractionPoints[i].position;
+		distances[i] = delta.length();
+	};
+	TREES_STATS_ADD(mStats, counter_distance_evaluations, distances.size());
+	
+	// find out what our closest vertice to each attraction points is, as our vertices haven't moved we only need to check any new vertices
+	// unless an earlier search only looked within a smaller radius, points further away than our search radius won't change our tree
+	float searchRadius = (pMaxDistance > pCutOffDistance ? pMaxDistance : pCutOffDistance);
+	bool exhaustive = (mSearchMode == search_brute_force) || (mSearchMode == search_simd);
+	bool catchUp = (exhaustive ? mSearchRadius < FLT_MAX : searchRadius > mSearchRadius);
+	if (mSearchMode == search_grid) {
+		findClosestUsingGrid(distances, searchRadius, catchUp);
+	} else if (mSearchMode == search_kdtree) {
+		mVertexTree.update(mVertices);
+	} else if ((mSearchMode == search_simd) && !mPointCloudLoaded) {
+		mPointCloud.load(mAttractionPoints);
+		mPointCloudLoaded = true;
+	};
+	
+	if (mParallel) {
+		// our workers do our search and count our points
+		countPointsInParallel(distances, pMaxDistance, pCutOffDistance, searchRadius, catchUp, numOfAPoints, directions, lastClosest, reached);
+	} else {
+		if (mSearchMode == search_kdtree) {
+			std::vector<long> stack;
+			findClosestUsingTree(distances, 0, distances.size(), searchRadius, catchUp, stack);
+		} else if (mSearchMode == search_simd) {
+			findClosestUsingSimd(distances, 0, distances.size(), catchUp);
+		} else if (mSearchMode == search_brute_force) {
+			findClosestBruteForce(distances, 0, distances.size(), catchUp);
+		};
+		
+		// now mark the points we've reached and count the rest towards their closest vertice
+		reached.assign(distances.size(), 0);
+		for (p = 0; p < distances.size(); p++) {
+			float currentDistance = distances[p];
+			
+			if (currentDistance < pCutOffDistance) {
+				// we're done with this one, we'll remove it once we're done
+				reached[p] = 1;
+			} else if (currentDistance < pMaxDistance) {
+				// count our vertice
+				unsigned long closest = mAttractionPoints[p].closestVertice;
+				numOfAPoints[closest] += 1.0;
+				vec3 norm = mAttractionPoints[p].position - mVertices[closest];
+				directions[closest] += norm.normalized();
+				lastClosest[closest] = p;
+			};
+		};
+	};
+	mSearchRadius = (exhaustive ? FLT_MAX : searchRadius);
+	
+	// Update our last number of vertices
+	mLastNumOfVerts = numVerts;
+	
+	// Now check which vertices need to branch out...
+	for (v = 0; v < numVerts; v++) {		
+		if (numOfAPoints[v] > 0.0) {
+			vec3	vert = mVertices[v];
+			directions[v] /= numOfAPoints[v];
+			float	len = directions[v].length();
+			if (len < 0.1f) {
+				// this means that our points are at opposite ends, if so we ignore the last attraction point
+				
+				// get the vector to our last attraction point
+				vec3 norm = mAttractionPoints[lastClosest[v]].position - vert;
+
+				// take it out
+				directions[v] *= numOfAPoints[v];
+				directions[v] -= norm.normalized();
+				directions[v] /= numOfAPoints[v] - 1;
+				
+				// recalculate our length
+				len = directions[v].length();
+			};
+			
+			// and check our length again to be safe
+			if (len < 0.1f) {
+				// if all else fails, just add an arbitrary distance
+				vert += vec3(0.0, 1.0, 0.0);
+			} else {
+				directions[v] /= len;
+				directions[v] *= pBranchSize;				
+				vert += directions[v] + pBias;				
+			};
+			
+			growBranch(v, vert);			
+			TREES_STATS_ADD(mStats, counter_branches_grown, 1);
+		};
+	};
+	
+	// this is where our memory use peaks
+	updatePeakMemory((numOfAPoints.capacity() * sizeof(float)) + (directions.capacity() * sizeof(vec3)) + (lastClosest.capacity() * sizeof(unsigned long)) + (distances.capacity() * sizeof(float)) + reached.capacity());
+	
+	// now remove the points we've reached in one go, keeping the others in order
+	i = 0;
+	for (p = 0; p < reached.size(); p++) {
+		if (!reached[p]) {
+			if (i != p) {
+				mAttractionPoints[i] = mAttractionPoints[p];
+			};
+			i++;
+		};
+	};
+	TREES_STATS_ADD(mStats, counter_points_killed, mAttractionPoints.size() - i);
+	mAttractionPoints.resize(i);
+	
+	if (mSearchMode == search_simd) {
+		mPointCloud.compact(reached);
+	} else if (mPointCloudLoaded) {
+		// other searches don't keep our point cloud up to date
+		mPointCloud.clear();
+		mPointCloudLoaded = false;
+	};
+	
+	TREES_STATS_END_ITERATION(mStats);
+	
+	// as long as we still have attraction points left we must still be growing our tree
+	return mAttractionPoints.size() > 0; 
+};
+
+/**
+ * optimiseNodes()
+ *
+ * This method will optimise nodes by joining nodes with small angles between them 
+ * Note that this will invalidate our childcount, we won't update this rather leave
+ * it up to the implementation whether to recount it or use the original counts
+ * 
+ **/
+void treebuilder::optimiseNodes() {
+	unsigned long node = 0;
+	bool		newNode = true;
+	vec3		parentVector;
+	
+	TREES_STATS_TIMER(mStats, stage_optimise);
+	TREES_TRACE_SCOPE("optimiseNodes");
+	
+	// we keep the counts from before we merged any nodes so make sure they're up to date
+	updateChildCounts();
+	buildChildIndex();
+	
+	if (mBatchOptimise) {
+		optimiseNodesBatched();
+		return;
+	};
+	
+	while (node < mNodes.size()) {
+		int mergeWith = -1;
+		
+		// see if we need to update our vector because we've got a new node
+		if (newNode) {
+			parentVector = mVertices[mNodes[node].b] - mVertices[mNodes[node].a];
+			parentVector = parentVector.normalized();			
+		};
+		
+		// we need to find out how many children we have, we can only optimise if just one is found
+		unsigned long firstChild = mChildStart[node + 1];
+		unsigned long numChildren = mChildStart[node + 2] - firstChild;
+		
+		// only one child? check if we need to merge
+		if (numChildren == 1) {
+			unsigned long child = mChildNodes[firstChild];
+			vec3	childVector = mVertices[mNodes[child].b] - mVertices[mNodes[child].a];
+			childVector = childVector.normalized();
+			
+			// use dot product, this gives our cosine, the closer to 1.0 the more the vectors match direction
+			float dot = parentVector % childVector;
+			if (dot > 0.995) {
+				mergeWith = child;
+			};
+		};
+		
+		// and merge
+		if (mergeWith != -1) {
+			unsigned long eraseVertice = mNodes[node].b; // should be same as mNodes[mergeWith].a, this we'll erase..
+			
+			// copy our node b from our merge node into our current node, then remove our merged node
+			mNodes[node].b = mNodes[mergeWith].b;			
+			mNodes.erase(mNodes.begin() + mergeWith);
+						
+			// adjust our other nodes
+			for (unsigned long n = 0; n < mNodes.size(); n++) {
+				if (mNodes[n].parent == mergeWith) { 
+					mNodes[n].parent = node;
+				} else if (mNodes[n].parent > mergeWith) {
+					mNodes[n].parent--;
+				};
+			};
+			
+			// our node now ends where our merged node ended and the nodes after our merged node have moved up
+			for (unsigned long v = 0; v < mVertexNodes.size(); v++) {
+				if (mVertexNodes[v] > mergeWith) {
+					mVertexNodes[v]--;
+				};
+			};
+			mVertexNodes[mNodes[node].b] = node;
+			
+			// our node numbers have changed so we need a new child index
+			buildChildIndex();
+
+			// erase our vertice we no longer need
+			remVertex(eraseVertice);
+			TREES_TRACE_INSTANT("merge");
+			
+			newNode = false; // we keep checking against our original vector!
+		} else {
+			node++;
+			newNode = true;
+		};
+	};
+};
+
+/**
+ * optimiseNodesBatched()
+ *
+ * Same as optimiseNodes but instead of removing each merged node and vertex straight away we mark them
+ * and remove them all at the end, renumbering our nodes in a single pass. We visit our nodes in the same
+ * order and test the same vectors so we end up with exactly the same skeleton.
+ * Our child index must be up to date.
+ **/
+void treebuilder::optimiseNodesBatched() {
+	unsigned long numNodes = mNodes.size();
+	std::vector<bool> removeNode(numNodes, false);
+	std::vector<bool> removeVertex(mVertices.size(), false);
+	std::vector<long> mergedInto(numNodes, -1);
+	
+	for (unsigned long node = 0; node < numNodes; node++) {
+		if (removeNode[node]) {
+			// already merged into an earlier node
+			continue;
+		};
+		
+		vec3 parentVector = mVertices[mNodes[node].b] - mVertices[mNodes[node].a];
+		parentVector = parentVector.normalized();
+		
+		// the children of the last node we merged are now our children
+		unsigned long last = node;
+		while ((mChildStart[last + 2] - mChildStart[last + 1]) == 1) {
+			unsigned long child = mChildNodes[mChildStart[last + 1]];
+			vec3	childVector = mVertices[mNodes[child].b] - mVertices[mNodes[child].a];
+			childVector = childVector.normalized();
+			
+			// use dot product, this gives our cosine, the closer to 1.0 the more the vectors match direction
+			float dot = parentVector % childVector;
+			if (dot > 0.995) {
+				// mark our merge, we keep checking against our original vector!
+				removeVertex[mNodes[node].b] = true;
+				mNodes[node].b = mNodes[child].b;
+				removeNode[child] = true;
+				mergedInto[child] = node;
+				last = child;
+				TREES_TRACE_INSTANT("merge");
+			} else {
+				break;
+			};
+		};
+	};
+	
+	// now remove our merged nodes, any node whose parent was merged now has the node it was merged into as its parent
+	TREES_TRACE_BEGIN("removeMerged");
+	std::vector<long> newIndex(numNodes);
+	unsigned long i = 0;
+	for (unsigned long n = 0; n < numNodes; n++) {
+		newIndex[n] = i;
+		if (!removeNode[n]) {
+			long parent = mNodes[n].parent;
+			if (parent != -1) {
+				if (removeNode[parent]) {
+					parent = mergedInto[parent];
+				};
+				parent = newIndex[parent];
+			};
+			
+			mNodes[i] = mNodes[n];
+			mNodes[i].parent = parent;
+			i++;
+		};
+	};
+	mNodes.resize(i);
+	
+	// our vertices now end our surviving nodes
+	for (unsigned long v = 0; v < mVertexNodes.size(); v++) {
+		mVertexNodes[v] = -1;
+	};
+	for (unsigned long n = 0; n < mNodes.size(); n++) {
+		mVertexNodes[mNodes[n].b] = n;
+	};
+	
+	// and erase the vertices we no longer need
+	remVertices(removeVertex);
+	
+	// our node numbers have changed so we need a new child index
+	buildChildIndex();
+	TREES_TRACE_END("removeMerged");
+};
+
+/**
+ * writeVertex(pCursor, pVertex, pNormal, pTexCoord)
+ *
+ * Writes a vertex of our mesh at our cursor, createModel has already sized our arrays
+ **/
+unsigned long treebuilder::writeVertex(meshCursor& pCursor, const vec3& pVertex, const vec3& pNormal, const vec2& pTexCoord) {
+	unsigned long p = pCursor.vertex++;
+	
+	mVertices[p] = pVertex;
+	mNormals[p] = pNormal;
+	mTexCoords[p] = pTexCoord;
+	if (mPackedVertices.format() != vertex_planar) {
+		mPackedVertices.set(p, pVertex, pNormal, pTexCoord);
+	};
+	
+	return p;
+};
+
+/**
+ * createSlice(pCursor, pCenter, pDir)
+ *
+ * This method creates a slice based on a center vertex and a direction vector
+ *
+ * pCursor		- where we write our vertices
+ * pCenter		- the center of our slice
+ * pPlaneNormal	- normal of our plane
+ * pBitangent	- direction vector within the plane of our previous slice.
+ * pSize		- size of our slice
+ * pDistance	- distance "travelled" along our tree, we use this for texture coordinates
+ *
+ **/
+slice treebuilder::createSlice(meshCursor& pCursor, vec3 pCenter, vec3 pPlaneNormal, vec3 pBitangent, float pSize, float pDistance) {
+	slice newSlice;
+	mat3  rotate;
+	float distFact = 50.0f;
+	
+	// create our vertices counter clockwise
+	rotate.rotate(-90.0f, pPlaneNormal);
+	
+	// just a safety in case our bitangent lies parallel to our normal
+	if ((pBitangent % pPlaneNormal) > 0.99) {
+		pBitangent = vec3(1.0, 0.0, 0.0);
+		pBitangent.normalized();
+	};
+	
+	// we use the bitangent of the previous plane to calculate our tangent
+	// this lines up our starting vertex better
+	vec3 tangent = pPlaneNormal * pBitangent;
+	tangent = tangent.normalized();
+	
+	// now create our vertices
+	newSlice.p[0] = writeVertex(pCursor, pCenter + (tangent * pSize), tangent, vec2(0, pDistance / distFact));
+	
+	vec3 dirB = rotate * tangent;
+	newSlice.p[1] = writeVertex(pCursor, pCenter + (dirB * pSize), dirB, vec2(0.25, pDistance / distFact));
+	
+	dirB = rotate * dirB;
+	newSlice.p[2] = writeVertex(pCursor, pCenter + (dirB * pSize), dirB, vec2(0.50, pDistance / distFact));
+	
+	dirB = rotate * dirB;
+	newSlice.p[3] = writeVertex(pCursor, pCenter + (dirB * pSize), dirB, vec2(0.75, pDistance / distFact));
+
+	// the last vertex is in the same location as the first but with different texture coords
+	newSlice.p[4] = writeVertex(pCursor, pCenter + (tangent * pSize), tangent, vec2(1.0, pDistance / distFact));
+	
+	return newSlice;
+};
+
+/**
+ * capSlice(pCursor, pSlice)
+ *
+ * Puts a cap at the end of a branch
+ **/
+void treebuilder::capSlice(meshCursor& pCursor, const slice& pSlice) {
+	quad& newQuad = mTreeElements[pCursor.quad++];
+
+	newQuad.v[0] = pSlice.p[3];
+	newQuad.v[1] = pSlice.p[2];
+	newQuad.v[2] = pSlice.p[1];
+	newQuad.v[3] = pSlice.p[0];
+};
+
+/**
+ * joinTwoSlices(pCursor, pA, pB)
+ *
+ * creates the quads that join these two slices
+ * 
+ **/
+void treebuilder::joinTwoSlices(meshCursor& pCursor, const slice& pA, const slice& pB) {
+	for (int i = 0; i < 4; i++) {
+		quad& newQuad = mTreeElements[pCursor.quad++];
+		
+		newQuad.v[0] = pB.p[i];
+		newQuad.v[1] = pB.p[i+1];
+		newQuad.v[2] = pA.p[i+1];
+		newQuad.v[3] = pA.p[i];
+	};
+};
+
+/**
+ * joinMultiSlices(pCursor, pSliceCount, pSlices)
+ * 
+ * creates quads and vertices for a split in our branches
+ *
+ **/
+void treebuilder::joinMultiSlices(meshCursor& pCursor, long pSliceCount, slice* pSlices) {
+	// for now we cheat, we just join them, but this should become a binary join of these meshes...
+	for (long s = 1; s < pSliceCount; s++) {
+		for (int i = 0; i < 4; i++) {
+			quad& newQuad = mTreeElements[pCursor.quad++];
+		
+			newQuad.v[0] = pSlices[s].p[i];
+			newQuad.v[1] = pSlices[s].p[i+1];
+			newQuad.v[2] = pSlices[0].p[i+1];
+			newQuad.v[3] = pSlices[0].p[i];
+		};		
+	};
+};
+
+/**
+ * addLeaves(pCursor, pCenter, pDirection)
+ *
+ * adds our branch
+ *
+ * Each leaf takes two random numbers and writes two triangles so we take our random numbers from the position
+ * of our first triangle, that way we get the same leaves no matter in which order our subtrees are expanded.
+ **/
+void treebuilder::addLeaves(meshCursor& pCursor, vec3 pCenter, vec3 pTangent, vec3 pBiTangent) {
+	unsigned long v[4];
+	unsigned long long counter = mLeavesRandom.counter() + pCursor.triangle;
+	
+	vec3 normal = pTangent * pBiTangent;
+	vec3 tangent = pTangent * mLeafSize.y * randomstream::toFloat(mLeavesRandom.at(counter), 0.8f, 1.0f);
+	vec3 bitangent = pBiTangent * mLeafSize.x * randomstream::toFloat(mLeavesRandom.at(counter + 1), 0.8f, 1.0f);
+	vec3 vertex = pCenter;
+		
+	vertex -= bitangent * 0.5f;
+	v[0] = writeVertex(pCursor, vertex, normal, vec2(0.0f, 1.0f));
+
+	vertex += tangent;
+	v[1] = writeVertex(pCursor, vertex, normal, vec2(0.0f, 0.0f));
+
+	vertex += bitangent;
+	v[2] = writeVertex(pCursor, vertex, normal, vec2(1.0f, 0.0f));
+
+	vertex -= tangent;
+	v[3] = writeVertex(pCursor, vertex, normal, vec2(1.0f, 1.0f));
+	
+	triangle& firstTriangle = mLeafElements[pCursor.triangle++];
+	
+	firstTriangle.v[0] = v[0];
+	firstTriangle.v[1] = v[1];
+	firstTriangle.v[2] = v[2];
+	
+	triangle& secondTriangle = mLeafElements[pCursor.triangle++];
+
+	secondTriangle.v[0] = v[0];
+	secondTriangle.v[1] = v[2];
+	secondTriangle.v[2] = v[3];
+};
+
+/**
+ * countSubtrees()
+ *
+ * Counts the vertices, quads and triangles expandChildren will write for the subtree of each node into
+ * mSubtreeCounts. Nodes are always added after their parent so we can do this in a single pass from back to front.
+ **/
+void treebuilder::countSubtrees() {
+	unsigned long numNodes = mNodes.size();
+	
+	mSubtreeCounts.resize(numNodes + 1);
+	for (unsigned long n = numNodes + 1; n > 0; n--) {
+		long			node			= n - 2; // -1 for our root nodes
+		unsigned long	firstChildNode	= mChildStart[n - 1];
+		unsigned long	numChildNodes	= mChildStart[n] - firstChildNode;
+		int				firstChild		= (node == -1 ? 0 : 1);
+		meshCursor&		counts			= mSubtreeCounts[n - 1];
+		
+		if (numChildNodes == 0) {
+			if (node == -1) {
+				// nothing???
+				counts.vertex = 0;
+				counts.quad = 0;
+				counts.triangle = 0;
+			} else {
+				// our cap and our two leaves
+				counts.vertex = 8;
+				counts.quad = 1;
+				counts.triangle = 4;
+			};
+		} else {
+			// joining our parent to our first slice
+			counts.vertex = 0;
+			counts.quad = 4 * firstChild;
+			counts.triangle = 0;
+			
+			if (numChildNodes > 1) {
+				// our slice at the split and our joining piece
+				counts.vertex += 5 * firstChild;
+				counts.quad += 4 * (numChildNodes + firstChild - 1);
+			};
+			
+			// and a slice and the subtree of each child
+			for (unsigned long c = 0; c < numChildNodes; c++) {
+				const meshCursor& childCounts = mSubtreeCounts[mChildNodes[firstChildNode + c] + 1];
+				
+				counts.vertex += 5 + childCounts.vertex;
+				counts.quad += childCounts.quad;
+				counts.triangle += childCounts.triangle;
+			};
+		};
+	};
+};
+
+/**
+ * expandChildren(pFrame, pCursor, pJobs, pJobSize)
+ *
+ * This method expands the model based on the child nodes of a parent
+ *
+ * We walk our tree with our own stack instead of recursing so very deep skeletons don't overflow the stack
+ * of the thread we run on. We visit our nodes and create our slices, vertices and elements in exactly the
+ * order a recursive walk would: the children of a node are handled one by one, each child's subtree is
+ * finished before we start on the next child and the joining piece is added once all children are done.
+ * A node with a single child simply continues with that child so long chains don't grow our stack.
+ *
+ * If pJobs is set we don't expand children whose subtree writes no more than pJobSize vertices, we add them
+ * to pJobs with the cursor they would have started at and skip our cursor past them. Once their slice is
+ * created a subtree doesn't need anything else from its parent so our workers can expand them afterwards.
+ *
+ * pFrame		- the node for which we're expanding to its children (-1 means we're doing our root nodes),
+ *				  the slice we created for it (empty for our root nodes), the offset and our distance so far
+ * pCursor		- where we write our vertices and elements, moved on past everything we write
+ * pJobs		- if not NULL, subtrees we leave for our workers
+ * pJobSize		- number of vertices below which we leave a subtree for our workers
+ *
+ **/
+void treebuilder::expandChildren(const expandFrame& pFrame, meshCursor& pCursor, std::vector<subtreeJob>* pJobs, unsigned long pJobSize) {
+	std::vector<expandFrame> stack;
+	std::vector<slice> slices; // slices of the nodes on our stack that have multiple children
+	
+	stack.push_back(pFrame);
+	stack.back().started = false;
+	stack.back().nextChild = 0;
+	stack.back().firstSlice = 0;
+	TREES_TRACE_BEGIN("expandChildren");
+	
+	while (!stack.empty()) {
+		expandFrame& frame = stack.back();
+		long parentNode = frame.node;
+		
+		// find out how many child nodes we have, note that our root nodes are in slot 0 of our child index
+		unsigned long	parentSlot		= (unsigned long) (parentNode + 1);
+		unsigned long	firstChildNode	= mChildStart[parentSlot];
+		unsigned long	numChildNodes	= mChildStart[parentSlot + 1] - firstChildNode;
+		const unsigned long* childNodes	= mChildNodes.data() + firstChildNode;
+		int				firstChild		= (parentNode == -1 ? 0 : 1);
+		
+		if (numChildNodes == 0) {
+			if (parentNode == -1) {
+				// nothing???
+			} else {
+				// cap our parent slice
+				capSlice(pCursor, frame.parentSlice);
+				
+				// and add our leaves
+				vec3	tangent	= mSkeletonVertices[mNodes[parentNode].b] - mSkeletonVertices[mNodes[parentNode].a];
+				tangent = tangent.normalized();
+				vec3	bitangent = tangent * mNormals[frame.parentSlice.p[0]];
+				bitangent = bitangent.normalized();
+				
+				addLeaves(pCursor, mSkeletonVertices[mNodes[parentNode].a] + frame.offset, tangent, bitangent);
+				addLeaves(pCursor, mSkeletonVertices[mNodes[parentNode].a] + frame.offset, tangent, bitangent * -1.0f);
+			};
+			
+			stack.pop_back();
+			TREES_TRACE_END("expandChildren");
+		} else if (numChildNodes == 1) {
+			// we just need to create a slice at our root
+			unsigned long	node	= childNodes[0];
+			float	size		= mNodes[node].childcount;
+			size = (size * mRadiusFactor) + mMinRadius;
+			vec3	direction	= mSkeletonVertices[mNodes[node].b] - mSkeletonVertices[mNodes[node].a];
+			float	len			= direction.length();
+			direction /= len;
+			if (parentNode != -1) {
+				vec3	parentDir	= mSkeletonVertices[mNodes[parentNode].b] - mSkeletonVertices[mNodes[parentNode].a];
+				direction += parentDir.normalized();
+				direction = direction.normalized();
+			};
+			
+			// our root nodes have no parent slice, we start off with the normal our first vertex had before we built our mesh
+			vec3	bitangent = (parentNode == -1 ? mSkeletonVertices[0].normalized() : mNormals[frame.parentSlice.p[3]]);
+			slice	childSlice	= createSlice(pCursor, mSkeletonVertices[mNodes[node].a] + frame.offset, direction, bitangent, size, frame.distance);
+			
+			if (parentNode != -1) {
+				// join parent to child
+				joinTwoSlices(pCursor, frame.parentSlice, childSlice);
+			};
+			
+			// there is nothing left to do for our parent once our child is done so our child takes its place
+			frame.node = node;
+			frame.parentSlice = childSlice;
+			frame.distance += len;
+			
+			const meshCursor& counts = mSubtreeCounts[node + 1];
+			if ((pJobs != NULL) && (counts.vertex <= pJobSize)) {
+				// leave our child for our workers
+				subtreeJob job;
+				job.frame = frame;
+				job.cursor = pCursor;
+				pJobs->push_back(job);
+				
+				pCursor.vertex += counts.vertex;
+				pCursor.quad += counts.quad;
+				pCursor.triangle += counts.triangle;
+				
+				stack.pop_back();
+				TREES_TRACE_END("expandChildren");
+			};
+		} else if (!frame.started) {
+			// reserve our slices, we fill in the slice of each child as we get to it
+			frame.started = true;
+			frame.firstSlice = slices.size();
+			slices.resize(frame.firstSlice + numChildNodes + firstChild);
+			frame.bitangent = vec3(1.0f, 0.0f, 0.0f);
+			
+			if (parentNode != -1) {
+				// draw our tree up to the point of our split
+				
+				float	size		= mNodes[parentNode].childcount;
+				size = (size * mRadiusFactor) + mMinRadius;
+				vec3	direction	= mSkeletonVertices[mNodes[parentNode].b] - mSkeletonVertices[mNodes[parentNode].a];
+				float	len			= direction.length();
+				direction /= len;
+				
+				frame.bitangent = mNormals[frame.parentSlice.p[3]];
+				slices[frame.firstSlice] = createSlice(pCursor, mSkeletonVertices[mNodes[parentNode].b] + frame.offset, direction, frame.bitangent, size, frame.distance);
+				frame.bitangent = mNormals[slices[frame.firstSlice].p[3]];
+				
+				// join final piece
+				joinTwoSlices(pCursor, frame.parentSlice, slices[frame.firstSlice]);
+				
+				// now add in some room..
+				frame.offset += direction * size;
+				frame.distance += size;
+			};
+		} else if (frame.nextChild < numChildNodes) {
+			unsigned long	n			= frame.nextChild;
+			unsigned long	node		= childNodes[n];
+			float	size		= mNodes[node].childcount;
+			size = (size * mRadiusFactor) + mMinRadius;
+			vec3	direction	= mSkeletonVertices[mNodes[node].b] - mSkeletonVertices[mNodes[node].a];
+			float	len			= direction.length();
+			direction /= len;
+			if (parentNode != -1) {
+				vec3	parentDir	= mSkeletonVertices[mNodes[parentNode].b] - mSkeletonVertices[mNodes[parentNode].a];
+				direction += parentDir.normalized();
+				direction = direction.normalized();
+			};
+			vec3	offset		= direction * size;
+			
+			slice	childSlice	= createSlice(pCursor, mSkeletonVertices[mNodes[node].a] + frame.offset + offset, direction, frame.bitangent, size, frame.distance + size);
+			slices[frame.firstSlice + n + firstChild] = childSlice;
+			frame.nextChild++;
+			
+			// and expand our child before we move on to our next child, pushing our child invalidates frame
+			expandFrame child;
+			child.node = node;
+			child.parentSlice = childSlice;
+			child.offset = frame.offset + offset;
+			child.distance = frame.distance + size + len;
+			child.started = false;
+			child.nextChild = 0;
+			child.firstSlice = 0;
+			
+			const meshCursor& counts = mSubtreeCounts[node + 1];
+			if ((pJobs != NULL) && (counts.vertex <= pJobSize)) {
+				// leave our child for our workers
+				subtreeJob job;
+				job.frame = child;
+				job.cursor = pCursor;
+				pJobs->push_back(job);
+				
+				pCursor.vertex += counts.vertex;
+				pCursor.quad += counts.quad;
+				pCursor.triangle += counts.triangle;
+			} else {
+				stack.push_back(child);
+				TREES_TRACE_BEGIN("expandChildren");
+			};
+		} else {
+			// now create joining piece
+			unsigned long firstSlice = frame.firstSlice;
+			joinMultiSlices(pCursor, numChildNodes + firstChild, &slices[firstSlice]);
+			
+			slices.resize(firstSlice);
+			stack.pop_back();
+			TREES_TRACE_END("expandChildren");
+		};
+	};
+};
+
+/**
+ * runModelJob(pData, pJob)
+ *
+ * Expands one of the subtrees createModel left for our workers
+ **/
+void treebuilder::runModelJob(void* pData, unsigned long pJob, int) {
+	TREES_TRACE_SCOPE("modelJob");
+	modelJob* job = (modelJob*) pData;
+	subtreeJob& subtree = (*job->subtrees)[pJob];
+	
+	job->tree->expandChildren(subtree.frame, subtree.cursor, NULL, 0);
+};
+
+#define		VERTEX_CACHE_WINDOW		8192
+
+/**
+ * reorderForVertexCache()
+ *
+ * Reorders the elements createModel just built so neighbouring elements share vertices while they're still in our
+ * GPUs vertex cache. Our vertices are then renumbered in the order our elements use them, bark first, so our GPU
+ * reads them in order. Our bark patches also run through our tessellation control shader once per vertex that
+ * misses our cache so they gain the most.
+ **/
+void treebuilder::reorderForVertexCache() {
+	TREES_STATS_TIMER(mStats, stage_vertex_cache);
+	TREES_TRACE_SCOPE("vertexCache");
+	
+	unsigned long numOfVertices = mVertices.size();
+	unsigned int* treeIndices = (unsigned int*) mTreeElements.data();
+	unsigned int* leafIndices = (unsigned int*) mLeafElements.data();
+	
+	mCacheStats.treeBefore = meshoptimiser::acmr(treeIndices, mTreeElements.size(), 4, numOfVertices);
+	mCacheStats.leafBefore = meshoptimiser::acmr(leafIndices, mLeafElements.size(), 3, numOfVertices);
+	
+	// large meshes are optimised a window at a time so our elements stay in roughly the order we built them, this keeps
+	// the vertices each element uses close together so our 16 bit index chunks can still reach them
+	unsigned long window = mTreeElements.size() + mLeafElements.size();
+	if (numOfVertices > INDEXBUFFER_MAX_RANGE) {
+		window = VERTEX_CACHE_WINDOW;
+	};
+	for (unsigned long p = 0; p < mTreeElements.size(); p += window) {
+		unsigned long count = (p + window < mTreeElements.size() ? window : mTreeElements.size() - p);
+		meshoptimiser::optimiseOrder(treeIndices + (p * 4), count, 4, mVertices);
+	};
+	for (unsigned long p = 0; p < mLeafElements.size(); p += window) {
+		unsigned long count = (p + window < mLeafElements.size() ? window : mLeafElements.size() - p);
+		meshoptimiser::optimiseOrder(leafIndices + (p * 3), count, 3, mVertices);
+	};
+	
+	// number our vertices in the order they're first used, any vertices we don't use go at the end
+	std::vector<unsigned long> newIndex(numOfVertices, MESHOPTIMISER_UNUSED);
+	unsigned long next = meshoptimiser::fetchOrder(treeIndices, mTreeElements.size() * 4, newIndex, 0);
+	next = meshoptimiser::fetchOrder(leafIndices, mLeafElements.size() * 3, newIndex, next);
+	for (unsigned long v = 0; v < numOfVertices; v++) {
+		if (newIndex[v] == MESHOPTIMISER_UNUSED) {
+			newIndex[v] = next++;
+		};
+	};
+	
+	meshoptimiser::remapIndices(treeIndices, mTreeElements.size() * 4, newIndex);
+	meshoptimiser::remapIndices(leafIndices, mLeafElements.size() * 3, newIndex);
+	
+	// we hold a second copy of one of our arrays while we move our vertices
+	updatePeakMemory((newIndex.capacity() * sizeof(unsigned long)) + (numOfVertices * sizeof(vec3)));
+	
+	std::vector<vec3> reordered(numOfVertices);
+	for (unsigned long v = 0; v < numOfVertices; v++) {
+		reordered[newIndex[v]] = mVertices[v];
+	};
+	mVertices.swap(reordered);
+	for (unsigned long v = 0; v < numOfVertices; v++) {
+		reordered[newIndex[v]] = mNormals[v];
+	};
+	mNormals.swap(reordered);
+	
+	std::vector<vec2> reorderedTexCoords(numOfVertices);
+	for (unsigned long v = 0; v < numOfVertices; v++) {
+		reorderedTexCoords[newIndex[v]] = mTexCoords[v];
+	};
+	mTexCoords.swap(reorderedTexCoords);
+	
+	mPackedVertices.reorder(newIndex);
+	
+	mCacheStats.treeAfter = meshoptimiser::acmr(treeIndices, mTreeElements.size(), 4, numOfVertices);
+	mCacheStats.leafAfter = meshoptimiser::acmr(leafIndices, mLeafElements.size(), 3, numOfVertices);
+};
+
+/**
+ * createModel()
+ * 
+ * This method will use our node tree to build a model of our tree
+ *
+ * We first count how many vertices and elements each subtree writes so we can allocate our mesh once at
+ * exactly the size we need and know up front where each subtree starts writing. Our current vertices move
+ * into our skeleton so our mesh starts at vertex 0 and we don't need to remove anything afterwards. If we're running in parallel we then expand the top of our
+ * tree ourselves and leave the subtrees below it to our workers, each writing into its own part of our arrays.
+ * Every subtree writes exactly what and where it would have if we had expanded our whole tree in one go so our
+ * mesh is the same no matter how many threads we use. Finally we can reorder our mesh for the vertex cache and
+ * write our elements as 16 bit indices.
+ **/
+#define		MODEL_JOBS_PER_THREAD	8
+#define		MODEL_MIN_JOB_SIZE		1024
+
+void treebuilder::createModel() {
+	TREES_STATS_TIMER(mStats, stage_model);
+	TREES_TRACE_SCOPE("createModel");
+	
+	// we need our childcounts to size our branches and our child index to find them
+	updateChildCounts();
+	buildChildIndex();
+	countSubtrees();
+	
+	// our vertices become our skeleton, we copy them so we don't keep the spare room our array grew into
+	std::vector<vec3>(mVertices.begin(), mVertices.end()).swap(mSkeletonVertices);
+	
+	// and we create new arrays for our mesh sized exactly for what we're about to write
+	const meshCursor& counts = mSubtreeCounts[0];
+	std::vector<vec3>(counts.vertex).swap(mVertices);
+	std::vector<vec3>(counts.vertex).swap(mNormals);
+	std::vector<vec2>(counts.vertex).swap(mTexCoords);
+	std::vector<long>(counts.vertex, -1).swap(mVertexNodes);
+	std::vector<quad>(counts.quad).swap(mTreeElements);
+	std::vector<triangle>(counts.triangle).swap(mLeafElements);
+	mPackedVertices.clear();
+	mPackedVertices.resize(counts.vertex);
+	mTreeIndices.clear();
+	mLeafIndices.clear();
+	mVertexTree.clear();
+	std::vector<iterationBuffers>().swap(mIterationBuffers);
+	mUpdateBuffers = true;
+	
+	// this is where our memory use peaks
+	updatePeakMemory(0);
+	
+	meshCursor cursor;
+	cursor.vertex = 0;
+	cursor.quad = 0;
+	cursor.triangle = 0;
+	
+	expandFrame root;
+	root.node = -1;
+	root.offset = vec3(0.0f, 0.0f, 0.0f);
+	root.distance = 0.0f;
+	
+	if (mParallel) {
+		if (mThreadPool == NULL) {
+			mThreadPool = new threadpool(mNumThreads);
+		};
+		
+		// make our jobs small enough to keep all our workers busy
+		unsigned long jobSize = counts.vertex / (mThreadPool->numThreads() * MODEL_JOBS_PER_THREAD);
+		if (jobSize < MODEL_MIN_JOB_SIZE) {
+			jobSize = MODEL_MIN_JOB_SIZE;
+		};
+		
+		std::vector<subtreeJob> subtrees;
+		expandChildren(root, cursor, &subtrees, jobSize);
+		
+		modelJob job;
+		job.tree = this;
+		job.subtrees = &subtrees;
+		mThreadPool->run(runModelJob, &job, subtrees.size());
+	} else {
+		expandChildren(root, cursor, NULL, 0);
+	};
+	
+	// our leaves took one random number for each triangle
+	mLeavesRandom.setCounter(mLeavesRandom.counter() + counts.triangle);
+	
+	if (mOptimiseVertexCache) {
+		reorderForVertexCache();
+	};
+	
+	if (mShortIndices) {
+		TREES_TRACE_SCOPE("shortIndices");
+		mTreeIndices.build((const unsigned int*) mTreeElements.data(), mTreeElements.size(), 4);
+		mLeafIndices.build((const unsigned int*) mLeafElements.data(), mLeafElements.size(), 3);
+		updatePeakMemory(0);
+	};
+	
+	// now move our nodes into our skeleton, we no longer need them...
+	std::vector<treenode>(mNodes.begin(), mNodes.end()).swap(mSkeletonNodes);
+	std::vector<treenode>().swap(mNodes);
+	std::vector<unsigned long>().swap(mChildStart);
+	std::vector<unsigned long>().swap(mChildNodes);
+	std::vector<meshCursor>().swap(mSubtreeCounts);
+};
+
+/**
+ * takeMesh(pMesh)
+ *
+ * Moves the mesh created by createModel into pMesh without copying it, our tree is left empty
+ **/
+void treebuilder::takeMesh(treemesh& pMesh) {
+	pMesh.clear();
+	pMesh.vertices.swap(mVertices);
+	pMesh.normals.swap(mNormals);
+	pMesh.texCoords.swap(mTexCoords);
+	pMesh.treeElements.swap(mTreeElements);
+	pMesh.leafElements.swap(mLeafElements);
+	pMesh.skeletonVertices.swap(mSkeletonVertices);
+	pMesh.skeletonNodes.swap(mSkeletonNodes);
+	
+	// we no longer have any vertices
+	mPackedVertices.clear();
+	mTreeIndices.clear();
+	mLeafIndices.clear();
+	mVertexNodes.clear();
+	mVertexTree.clear();
+	mUpdateBuffers = true;
+};
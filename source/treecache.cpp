@@ -0,0 +1,360 @@
+/********************************************************************
+ * treecache keeps generated trees on disk
+ *
+ * Trees are stored in a file named after a hash of everything that
+ * determines how the tree turns out, so asking for the same tree
+ * twice only generates it once. We delete the trees used least
+ * recently when our cache grows beyond its maximum size.
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treecache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+// our trees are stored as meshfiles with our key in their key section
+#define		TREECACHE_EXTENSION		".tree"
+
+// a file in our cache, used when evicting
+class cacheEntry {
+public:
+	std::string			fileName;
+	time_t				lastUsed;
+	unsigned long long	size;
+	
+	bool operator<(const cacheEntry& pOther) const {
+		return lastUsed < pOther.lastUsed;
+	};
+};
+
+// helpers for building our key, values are added in our native byte order
+static void addBytes(std::vector<unsigned char>& pKey, const void* pData, size_t pSize) {
+	const unsigned char* data = (const unsigned char*) pData;
+	pKey.insert(pKey.end(), data, data + pSize);
+};
+
+static void addFloat(std::vector<unsigned char>& pKey, float pValue) {
+	addBytes(pKey, &pValue, sizeof(float));
+};
+
+static void addULL(std::vector<unsigned char>& pKey, unsigned long long pValue) {
+	addBytes(pKey, &pValue, sizeof(unsigned long long));
+};
+
+static void addVec3(std::vector<unsigned char>& pKey, const vec3& pValue) {
+	addFloat(pKey, pValue.x);
+	addFloat(pKey, pValue.y);
+	addFloat(pKey, pValue.z);
+};
+
+/////////////////////////////////////////////////////////////////////
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * treecache(pDirectory, pMaxSize)
+ *
+ * Opens our cache in pDirectory, creating the directory if needed
+ *
+ * pDirectory	- directory to store our trees in
+ * pMaxSize		- maximum size of all our trees in bytes, 0 if we never evict
+ **/
+treecache::treecache(const std::string& pDirectory, unsigned long long pMaxSize) {
+	mDirectory = pDirectory;
+	mMaxSize = pMaxSize;
+	mHits = 0;
+	mMisses = 0;
+	pthread_mutex_init(&mMutex, NULL);
+	
+	// if this fails we'll simply never find anything
+	mkdir(mDirectory.c_str(), 0755);
+};
+
+treecache::~treecache() {
+	pthread_mutex_destroy(&mMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+const std::string& treecache::directory() const {
+	return mDirectory;
+};
+
+unsigned long long treecache::maxSize() const {
+	return mMaxSize;
+};
+
+void treecache::setMaxSize(unsigned long long pMaxSize) {
+	mMaxSize = pMaxSize;
+};
+
+unsigned long treecache::hits() {
+	pthread_mutex_lock(&mMutex);
+	unsigned long hits = mHits;
+	pthread_mutex_unlock(&mMutex);
+	
+	return hits;
+};
+
+unsigned long treecache::misses() {
+	pthread_mutex_lock(&mMutex);
+	unsigned long misses = mMisses;
+	pthread_mutex_unlock(&mMutex);
+	
+	return misses;
+};
+
+/////////////////////////////////////////////////////////////////////
+// files
+/////////////////////////////////////////////////////////////////////
+
+std::string treecache::fileName(const std::vector<unsigned char>& pKey) const {
+	char name[32];
+	sprintf(name, "%016llx", hash(pKey));
+	
+	return mDirectory + "/" + name + TREECACHE_EXTENSION;
+};
+
+/**
+ * openFile(pFileName, pKey, pFile)
+ *
+ * Maps our mesh in pFileName into memory, returns false if the file doesn't exist, is damaged or belongs to a different key
+ **/
+bool treecache::openFile(const std::string& pFileName, const std::vector<unsigned char>& pKey, meshfile& pFile) const {
+	if (!pFile.open(pFileName)) {
+		return false;
+	};
+	
+	// make sure this isn't a different tree with the same hash
+	if ((pFile.keySize() != pKey.size()) || (memcmp(pFile.key(), pKey.data(), pKey.size()) != 0)) {
+		pFile.close();
+		return false;
+	};
+	
+	return true;
+};
+
+/**
+ * writeFile(pFileName, pKey, pMesh)
+ *
+ * Writes our mesh to a temporary file and then moves it into place so nobody ever sees a half written file.
+ * We validate our file once here so opening it later doesn't have to read all of its indices.
+ **/
+bool treecache::writeFile(const std::string& pFileName, const std::vector<unsigned char>& pKey, const treemesh& pMesh) const {
+	std::string tempName = mDirectory + "/.writingXXXXXX";
+	int fd = mkstemp(&tempName[0]);
+	if (fd == -1) {
+		return false;
+	};
+	
+	// mkstemp only gives us access, others using our cache need to be able to read it too
+	fchmod(fd, 0644);
+	close(fd);
+	
+	if (meshfile::write(tempName, pMesh, &pKey)) {
+		meshfile file;
+		bool valid = file.open(tempName) && file.validate();
+		file.close();
+		
+		if (valid && (rename(tempName.c_str(), pFileName.c_str()) == 0)) {
+			return true;
+		};
+	};
+	
+	unlink(tempName.c_str());
+	return false;
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * open(pSpec, pFile, pParallel)
+ *
+ * Maps the tree for pSpec into memory without copying it, returns false if we don't have it.
+ * pFile stays valid even if our tree is evicted while it is open.
+ * Set pParallel if the tree would be grown in parallel, see makeKey.
+ **/
+bool treecache::open(const treespec& pSpec, meshfile& pFile, bool pParallel) {
+	std::vector<unsigned char> key;
+	makeKey(pSpec, pParallel, key);
+	
+	std::string name = fileName(key);
+	bool found = openFile(name, key, pFile);
+	if (found) {
+		// mark our tree as recently used
+		utime(name.c_str(), NULL);
+	};
+	
+	pthread_mutex_lock(&mMutex);
+	if (found) {
+		mHits++;
+	} else {
+		mMisses++;
+	};
+	pthread_mutex_unlock(&mMutex);
+	
+	return found;
+};
+
+/**
+ * load(pSpec, pMesh, pParallel)
+ *
+ * Loads a copy of the tree for pSpec from our cache, returns false if we don't have it
+ **/
+bool treecache::load(const treespec& pSpec, treemesh& pMesh, bool pParallel) {
+	meshfile file;
+	if (!open(pSpec, file, pParallel)) {
+		return false;
+	};
+	
+	file.copyTo(pMesh);
+	return true;
+};
+
+/**
+ * store(pSpec, pMesh, pParallel)
+ *
+ * Adds the tree for pSpec to our cache and evicts old trees if we've grown too large.
+ * Set pParallel if pMesh was grown in parallel.
+ **/
+bool treecache::store(const treespec& pSpec, const treemesh& pMesh, bool pParallel) {
+	std::vector<unsigned char> key;
+	makeKey(pSpec, pParallel, key);
+	
+	bool success = writeFile(fileName(key), key, pMesh);
+	if (success && (mMaxSize > 0)) {
+		evict();
+	};
+	
+	return success;
+};
+
+/**
+ * getTree(pSpec, pMesh)
+ *
+ * Loads the tree for pSpec from our cache, if we don't have it we generate it and add it to our cache
+ **/
+void treecache::getTree(const treespec& pSpec, treemesh& pMesh) {
+	if (!load(pSpec, pMesh)) {
+		forest::buildTree(pSpec, pMesh);
+		store(pSpec, pMesh);
+	};
+};
+
+/**
+ * evict()
+ *
+ * Deletes the trees we've used least recently until our cache fits within our maximum size
+ **/
+void treecache::evict() {
+	pthread_mutex_lock(&mMutex);
+	
+	DIR* dir = opendir(mDirectory.c_str());
+	if (dir != NULL) {
+		std::vector<cacheEntry> entries;
+		unsigned long long totalSize = 0;
+		size_t extLen = strlen(TREECACHE_EXTENSION);
+		
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			size_t len = strlen(entry->d_name);
+			if ((len > extLen) && (strcmp(entry->d_name + len - extLen, TREECACHE_EXTENSION) == 0)) {
+				cacheEntry newEntry;
+				newEntry.fileName = mDirectory + "/" + entry->d_name;
+				
+				struct stat info;
+				if (stat(newEntry.fileName.c_str(), &info) == 0) {
+					newEntry.lastUsed = info.st_mtime;
+					newEntry.size = info.st_size;
+					totalSize += newEntry.size;
+					entries.push_back(newEntry);
+				};
+			};
+		};
+		closedir(dir);
+		
+		// oldest first
+		std::sort(entries.begin(), entries.end());
+		for (unsigned long e = 0; (e < entries.size()) && (totalSize > mMaxSize); e++) {
+			if (unlink(entries[e].fileName.c_str()) == 0) {
+				totalSize -= entries[e].size;
+			};
+		};
+	};
+	
+	pthread_mutex_unlock(&mMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * makeKey(pSpec, pParallel, pKey)
+ *
+ * Builds our key out of everything in pSpec that changes the tree we generate. Our search mode and our
+ * number of threads don't change our tree so we leave them out, but growing in parallel adds up our
+ * directions in fixed point and gives a slightly different tree than growing serially so that is part of our key.
+ **/
+void treecache::makeKey(const treespec& pSpec, bool pParallel, std::vector<unsigned char>& pKey) {
+	pKey.clear();
+	
+	addULL(pKey, TREECACHE_GENERATOR);
+	addULL(pKey, pSpec.seed);
+	addVec3(pKey, pSpec.trunk);
+	
+	addULL(pKey, pSpec.clouds.size());
+	for (unsigned long c = 0; c < pSpec.clouds.size(); c++) {
+		const cloudspec& cloud = pSpec.clouds[c];
+		addULL(pKey, cloud.numOfPoints);
+		addFloat(pKey, cloud.outerRadius);
+		addFloat(pKey, cloud.innerRadius);
+		addFloat(pKey, cloud.aspect);
+		addFloat(pKey, cloud.offsetY);
+	};
+	
+	addULL(pKey, pSpec.stages.size());
+	for (unsigned long s = 0; s < pSpec.stages.size(); s++) {
+		const growspec& stage = pSpec.stages[s];
+		addFloat(pKey, stage.maxDistance);
+		addFloat(pKey, stage.branchSize);
+		addFloat(pKey, stage.cutOffDistance);
+		addVec3(pKey, stage.bias);
+	};
+	
+	addULL(pKey, pSpec.optimise ? 1 : 0);
+	addFloat(pKey, pSpec.minRadius);
+	addFloat(pKey, pSpec.radiusFactor);
+	addFloat(pKey, pSpec.leafSize.x);
+	addFloat(pKey, pSpec.leafSize.y);
+	addULL(pKey, pSpec.optimiseVertexCache ? 1 : 0);
+	addULL(pKey, pParallel ? 1 : 0);
+};
+
+/**
+ * hash(pKey)
+ *
+ * 64 bit FNV-1a hash of our key, we use this as our file name
+ **/
+unsigned long long treecache::hash(const std::vector<unsigned char>& pKey) {
+	unsigned long long hash = 14695981039346656037ULL;
+	
+	for (unsigned long i = 0; i < pKey.size(); i++) {
+		hash ^= pKey[i];
+		hash *= 1099511628211ULL;
+	};
+	
+	return hash;
+};
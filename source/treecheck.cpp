@@ -0,0 +1,527 @@
+/********************************************************************
+ * Our checks
+ *
+ * Generates a few small seeded trees and makes sure the different
+ * ways we have of generating them agree with each other. Each check
+ * prints what went wrong and we exit with a failure if any of them
+ * failed. Build and run with "make check".
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treecheck.h"
+
+// a check we run, returns true if it passed
+typedef bool (*checkFunction)();
+
+class check {
+public:
+	const char*		name;
+	const char*		description;
+	checkFunction	run;
+};
+
+/**
+ * pointsSpec(pNumOfPoints, pSeed)
+ *
+ * Our default tree with pNumOfPoints points in its inner cloud and its outer clouds scaled to match, like treebatch -p
+ **/
+treespec pointsSpec(unsigned long pNumOfPoints, unsigned long long pSeed) {
+	treespec spec;
+	spec.seed = pSeed;
+	spec.clouds[0].numOfPoints = pNumOfPoints;
+	spec.clouds[1].numOfPoints = pNumOfPoints * 3 / 8;
+	spec.clouds[2].numOfPoints = pNumOfPoints / 16;
+
+	return spec;
+};
+
+/**
+ * sameArray(pA, pB)
+ *
+ * Returns true if both arrays hold exactly the same bytes
+ **/
+template <class T> bool sameArray(const std::vector<T>& pA, const std::vector<T>& pB) {
+	if (pA.size() != pB.size()) {
+		return false;
+	};
+
+	return pA.empty() || (memcmp(pA.data(), pB.data(), pA.size() * sizeof(T)) == 0);
+};
+
+/**
+ * sameMesh(pA, pB)
+ *
+ * Returns true if both meshes are exactly the same, down to the last bit of every float
+ **/
+bool sameMesh(const treemesh& pA, const treemesh& pB) {
+	if (!sameArray(pA.vertices, pB.vertices) || !sameArray(pA.normals, pB.normals) || !sameArray(pA.texCoords, pB.texCoords)) {
+		return false;
+	};
+	if (!sameArray(pA.treeElements, pB.treeElements) || !sameArray(pA.leafElements, pB.leafElements)) {
+		return false;
+	};
+	if (!sameArray(pA.skeletonVertices, pB.skeletonVertices) || (pA.skeletonNodes.size() != pB.skeletonNodes.size())) {
+		return false;
+	};
+
+	for (unsigned long n = 0; n < pA.skeletonNodes.size(); n++) {
+		const treenode& a = pA.skeletonNodes[n];
+		const treenode& b = pB.skeletonNodes[n];
+		if ((a.a != b.a) || (a.b != b.b) || (a.parent != b.parent) || (a.childcount != b.childcount)) {
+			return false;
+		};
+	};
+
+	return true;
+};
+
+/**
+ * storeMesh(pData, pTree, pMesh)
+ *
+ * Our forest callback, keeps each mesh in the vector pData points to
+ **/
+void storeMesh(void* pData, unsigned long pTree, treemesh& pMesh) {
+	std::vector<treemesh>* meshes = (std::vector<treemesh>*) pData;
+	(*meshes)[pTree].swap(pMesh);
+};
+
+/**
+ * makeDirectory(pDirectory)
+ *
+ * Creates a new empty directory for a check to write its files to, returns false if we couldn't
+ **/
+bool makeDirectory(std::string& pDirectory) {
+	char name[] = "/tmp/treecheckXXXXXX";
+	if (mkdtemp(name) == NULL) {
+		return false;
+	};
+
+	pDirectory = name;
+	return true;
+};
+
+/**
+ * removeDirectory(pDirectory)
+ *
+ * Removes a directory created by makeDirectory and all the files in it
+ **/
+void removeDirectory(const std::string& pDirectory) {
+	DIR* dir = opendir(pDirectory.c_str());
+	if (dir != NULL) {
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if ((strcmp(entry->d_name, ".") != 0) && (strcmp(entry->d_name, "..") != 0)) {
+				unlink((pDirectory + "/" + entry->d_name).c_str());
+			};
+		};
+		closedir(dir);
+	};
+
+	rmdir(pDirectory.c_str());
+};
+
+/**
+ * cacheFileName(pDirectory, pSpec)
+ *
+ * The file treecache stores the serially grown tree for pSpec in
+ **/
+std::string cacheFileName(const std::string& pDirectory, const treespec& pSpec) {
+	std::vector<unsigned char> key;
+	treecache::makeKey(pSpec, false, key);
+
+	char name[32];
+	sprintf(name, "/%016llx.tree", treecache::hash(key));
+	return pDirectory + name;
+};
+
+/////////////////////////////////////////////////////////////////////
+// checks
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * checkSearchModes()
+ *
+ * Our search modes only change how we find the closest vertice for each attraction point so they must all grow
+ * exactly the same tree, and growing in parallel must give the same tree no matter how many threads we use.
+ * Growing in parallel adds up our directions in fixed point where growing serially uses floats, so we compare
+ * our serial trees with each other and our parallel trees with each other.
+ **/
+bool checkSearchModes() {
+	const searchModes modes[4] = { search_brute_force, search_grid, search_kdtree, search_simd };
+	const char* modeNames[4] = { "brute", "grid", "kdtree", "simd" };
+	const int threads[3] = { 1, 2, 4 };
+	const unsigned long long seeds[2] = { 0, 7 };
+	bool success = true;
+
+	for (int s = 0; s < 2; s++) {
+		treespec spec = pointsSpec(2000, seeds[s]);
+		treemesh serial;
+		treemesh parallel;
+
+		for (int m = 0; m < 4; m++) {
+			treemesh mesh;
+			spec.searchMode = modes[m];
+			forest::buildTree(spec, mesh);
+			if (m == 0) {
+				serial.swap(mesh);
+			} else if (!sameMesh(serial, mesh)) {
+				printf("  seed %llu: %s grows a different tree than brute\n", seeds[s], modeNames[m]);
+				success = false;
+			};
+
+			for (int t = 0; t < 3; t++) {
+				forest::buildTree(spec, mesh, threads[t]);
+				if ((m == 0) && (t == 0)) {
+					parallel.swap(mesh);
+				} else if (!sameMesh(parallel, mesh)) {
+					printf("  seed %llu: %s on %d threads grows a different tree than brute on %d thread\n", seeds[s], modeNames[m], threads[t], threads[0]);
+					success = false;
+				};
+			};
+		};
+	};
+
+	return success;
+};
+
+/**
+ * checkSeeds()
+ *
+ * Each tree has its own random generator so growing the same spec twice, even at the same time on different
+ * threads, must give the same tree while a different seed gives a different tree
+ **/
+bool checkSeeds() {
+	bool success = true;
+	treespec spec = pointsSpec(1000, 3);
+	treemesh first;
+	treemesh second;
+
+	forest::buildTree(spec, first);
+	forest::buildTree(spec, second);
+	if (!sameMesh(first, second)) {
+		printf("  the same seed grew two different trees\n");
+		success = false;
+	};
+
+	// each tree in a forest is grown on one of our workers
+	forest trees(4);
+	std::vector<treespec> specs(8, spec);
+	std::vector<treemesh> meshes(specs.size());
+	trees.generate(specs, storeMesh, &meshes);
+	for (unsigned long t = 0; t < meshes.size(); t++) {
+		if (!sameMesh(first, meshes[t])) {
+			printf("  tree %lu of our forest is different from the same tree grown on its own\n", t);
+			success = false;
+		};
+	};
+
+	spec.seed = 4;
+	forest::buildTree(spec, second);
+	if (sameMesh(first, second)) {
+		printf("  a different seed grew the same tree\n");
+		success = false;
+	};
+
+	return success;
+};
+
+/**
+ * checkCache()
+ *
+ * Our cache key must only change when our tree changes, a tree we've stored must come back exactly as we stored it
+ * and evicting must remove the trees we've used least recently, going by the modification time of their files
+ **/
+bool checkCache() {
+	std::string directory;
+	if (!makeDirectory(directory)) {
+		printf("  couldn't create a directory for our cache\n");
+		return false;
+	};
+
+	bool success = true;
+	treespec spec = pointsSpec(500, 1);
+	std::vector<unsigned char> key;
+	std::vector<unsigned char> otherKey;
+
+	// our key
+	treecache::makeKey(spec, false, key);
+	treecache::makeKey(spec, false, otherKey);
+	if (key != otherKey) {
+		printf("  the same spec gave two different keys\n");
+		success = false;
+	};
+
+	treespec other = spec;
+	other.searchMode = search_grid;
+	treecache::makeKey(other, false, otherKey);
+	if (key != otherKey) {
+		printf("  our search mode changed our key\n");
+		success = false;
+	};
+
+	other = spec;
+	other.seed = 2;
+	treecache::makeKey(other, false, otherKey);
+	if (key == otherKey) {
+		printf("  our seed didn't change our key\n");
+		success = false;
+	};
+
+	treecache::makeKey(spec, true, otherKey);
+	if (key == otherKey) {
+		printf("  growing in parallel didn't change our key\n");
+		success = false;
+	};
+
+	// a miss followed by a hit
+	treecache cache(directory);
+	treemesh mesh;
+	treemesh cached;
+	if (cache.load(spec, cached) || (cache.misses() != 1)) {
+		printf("  found a tree in an empty cache\n");
+		success = false;
+	};
+
+	cache.getTree(spec, mesh);
+	if (!cache.load(spec, cached) || (cache.hits() != 1) || !sameMesh(mesh, cached)) {
+		printf("  didn't get back the tree we stored\n");
+		success = false;
+	};
+
+	if (cache.load(spec, cached, true)) {
+		printf("  got a serially grown tree when asking for one grown in parallel\n");
+		success = false;
+	};
+
+	// store three more trees and make our first tree the least recently used, with room for only the newest two
+	// our first two trees must be evicted
+	treespec specs[4];
+	unsigned long long keepSize = 0;
+	specs[0] = spec;
+	for (int t = 1; t < 4; t++) {
+		specs[t] = pointsSpec(500, 10 + t);
+		cache.getTree(specs[t], mesh);
+	};
+	for (int t = 0; t < 4; t++) {
+		std::string fileName = cacheFileName(directory, specs[t]);
+		struct utimbuf times;
+		times.actime = 1000000000 + (t * 100);
+		times.modtime = times.actime;
+		struct stat info;
+		if ((utime(fileName.c_str(), &times) != 0) || (stat(fileName.c_str(), &info) != 0)) {
+			printf("  couldn't find the file for tree %d\n", t);
+			success = false;
+		} else if (t >= 2) {
+			keepSize += info.st_size;
+		};
+	};
+
+	cache.setMaxSize(keepSize);
+	cache.evict();
+	for (int t = 0; t < 4; t++) {
+		bool found = cache.load(specs[t], cached);
+		if (found != (t >= 2)) {
+			printf("  tree %d was %s\n", t, found ? "kept" : "evicted");
+			success = false;
+		};
+	};
+
+	removeDirectory(directory);
+	return success;
+};
+
+/**
+ * checkMeshFile()
+ *
+ * A mesh we write to a file must come back exactly as we wrote it. Files that are cut short or aren't mesh files
+ * must fail to open and files whose indices refer past the end of their arrays must fail to validate, our cache
+ * must refuse to store those.
+ **/
+bool checkMeshFile() {
+	std::string directory;
+	if (!makeDirectory(directory)) {
+		printf("  couldn't create a directory for our files\n");
+		return false;
+	};
+
+	bool success = true;
+	treespec spec = pointsSpec(500, 5);
+	treemesh mesh;
+	forest::buildTree(spec, mesh);
+
+	std::string fileName = directory + "/check.tree";
+	std::vector<unsigned char> key;
+	for (int i = 0; i < 20; i++) {
+		key.push_back(i * 7);
+	};
+
+	// round trip
+	meshfile file;
+	if (!meshfile::write(fileName, mesh, &key)) {
+		printf("  couldn't write %s\n", fileName.c_str());
+		success = false;
+	} else if (!file.open(fileName) || !file.validate()) {
+		printf("  couldn't open the file we wrote\n");
+		success = false;
+	} else {
+		treemesh copy;
+		file.copyTo(copy);
+		if (!sameMesh(mesh, copy)) {
+			printf("  our mesh changed on its way through our file\n");
+			success = false;
+		};
+		if ((file.keySize() != key.size()) || (memcmp(file.key(), key.data(), key.size()) != 0)) {
+			printf("  our key changed on its way through our file\n");
+			success = false;
+		};
+	};
+	file.close();
+
+	// cut short anywhere, including in the middle of our header
+	struct stat info;
+	stat(fileName.c_str(), &info);
+	const off_t lengths[3] = { info.st_size - 1, info.st_size / 2, 16 };
+	for (int l = 0; l < 3; l++) {
+		meshfile::write(fileName, mesh, &key);
+		if ((truncate(fileName.c_str(), lengths[l]) != 0) || file.open(fileName)) {
+			printf("  opened our file cut short to %lld bytes\n", (long long) lengths[l]);
+			success = false;
+		};
+		file.close();
+	};
+
+	// not one of our files
+	meshfile::write(fileName, mesh, &key);
+	FILE* damaged = fopen(fileName.c_str(), "r+b");
+	if (damaged != NULL) {
+		fputc('X', damaged);
+		fclose(damaged);
+	};
+	if (file.open(fileName)) {
+		printf("  opened a file with the wrong magic\n");
+		success = false;
+	};
+	file.close();
+
+	// indices past the end of our arrays
+	const char* damageNames[4] = { "a bark index", "a leaf index", "a skeleton vertex", "a parent node" };
+	treecache cache(directory);
+	for (int d = 0; d < 4; d++) {
+		treemesh bad = mesh;
+		switch (d) {
+			case 0: {
+				bad.treeElements.back().v[2] = bad.vertices.size();
+			} break;
+			case 1: {
+				bad.leafElements.back().v[1] = bad.vertices.size();
+			} break;
+			case 2: {
+				bad.skeletonNodes.back().b = bad.skeletonVertices.size();
+			} break;
+			default: {
+				bad.skeletonNodes.back().parent = bad.skeletonNodes.size();
+			} break;
+		};
+
+		meshfile::write(fileName, bad, &key);
+		if (file.open(fileName) && file.validate()) {
+			printf("  validated a file with %s out of range\n", damageNames[d]);
+			success = false;
+		};
+		file.close();
+
+		if (cache.store(spec, bad) || cache.load(spec, bad)) {
+			printf("  our cache stored a mesh with %s out of range\n", damageNames[d]);
+			success = false;
+		};
+	};
+
+	removeDirectory(directory);
+	return success;
+};
+
+/////////////////////////////////////////////////////////////////////
+// main
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * makeChecks(pChecks)
+ *
+ * All the checks we run, in the order we run them
+ **/
+void makeChecks(std::vector<check>& pChecks) {
+	check newCheck;
+
+	newCheck.name = "search_modes";
+	newCheck.description = "every search mode and thread count grows the same tree";
+	newCheck.run = checkSearchModes;
+	pChecks.push_back(newCheck);
+
+	newCheck.name = "seeds";
+	newCheck.description = "the same seed grows the same tree, on its own or in a forest";
+	newCheck.run = checkSeeds;
+	pChecks.push_back(newCheck);
+
+	newCheck.name = "cache";
+	newCheck.description = "cache keys, a hit after a miss and evicting the least recently used trees";
+	newCheck.run = checkCache;
+	pChecks.push_back(newCheck);
+
+	newCheck.name = "meshfile";
+	newCheck.description = "a mesh file round trip, rejecting damaged files";
+	newCheck.run = checkMeshFile;
+	pChecks.push_back(newCheck);
+};
+
+void usage() {
+	printf("Usage: treecheck [options]\n");
+	printf("  -f <name>      only run checks whose name contains this\n");
+	printf("  -l             list our checks\n");
+};
+
+int main(int argc, char** argv) {
+	const char* filter = NULL;
+	bool list = false;
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc)) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "-l") == 0) {
+			list = true;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		};
+	};
+
+	std::vector<check> checks;
+	makeChecks(checks);
+
+	unsigned long failed = 0;
+	for (unsigned long c = 0; c < checks.size(); c++) {
+		if ((filter != NULL) && (strstr(checks[c].name, filter) == NULL)) {
+			continue;
+		};
+
+		if (list) {
+			printf("%-16s %s\n", checks[c].name, checks[c].description);
+		} else {
+			printf("%s\n", checks[c].name);
+			fflush(stdout);
+			if (checks[c].run()) {
+				printf("  ok\n");
+			} else {
+				printf("  FAILED\n");
+				failed++;
+			};
+		};
+	};
+
+	if (failed > 0) {
+		printf("%lu checks failed\n", failed);
+		return EXIT_FAILURE;
+	};
+
+	return EXIT_SUCCESS;
+};
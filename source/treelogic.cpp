@@ -1,84 +1,11 @@
 /********************************************************************
- * treelogic contains the logic to generate our tree
- * 
- * Implementation based on the "Space Colonization Algorithm" by
- * Adam Runions, Brendan Lane, and Przemyslaw Prusinkiewicz
+ * treelogic renders the tree generated by treebuilder
  * 
  * By Bastiaan Olij - 2014
 ********************************************************************/
 
 #include "treelogic.h"
 
-/////////////////////////////////////////////////////////////////////
-// class for a slice
-/////////////////////////////////////////////////////////////////////
-
-slice::slice() {
-	for (int i = 0; i < 5; i++) {
-		p[i] = 0;
-	};
-};
-
-slice::slice(const slice& pCopy) {
-	for (int i = 0; i < 5; i++) {
-		p[i] = pCopy.p[i];
-	};	
-};
-
-slice& slice::operator=(const slice& pCopy) {
-	for (int i = 0; i < 5; i++) {
-		p[i] = pCopy.p[i];
-	};
-	
-	return (*this);
-};
-
-/////////////////////////////////////////////////////////////////////
-// class for a triangle
-/////////////////////////////////////////////////////////////////////
-
-triangle::triangle() {
-	for (int i = 0; i < 3; i++) {
-		v[i] = 0;
-	};	
-};
-
-triangle::triangle(const triangle& pCopy) {
-	for (int i = 0; i < 3; i++) {
-		v[i] = pCopy.v[i];
-	};		
-};
-
-triangle& triangle::operator=(const triangle& pCopy) {
-	for (int i = 0; i < 3; i++) {
-		v[i] = pCopy.v[i];
-	};		
-	return (*this);
-};
-
-/////////////////////////////////////////////////////////////////////
-// class for a quad
-/////////////////////////////////////////////////////////////////////
-
-quad::quad() {
-	for (int i = 0; i < 4; i++) {
-		v[i] = 0;
-	};
-};
-
-quad::quad(const quad& pCopy) {
-	for (int i = 0; i < 4; i++) {
-		v[i] = pCopy.v[i];
-	};	
-};
-	
-quad& quad::operator=(const quad& pCopy) {
-	for (int i = 0; i < 4; i++) {
-		v[i] = pCopy.v[i];
-	};	
-	return (*this);
-};
-
 /////////////////////////////////////////////////////////////////////
 // TreeLogic
 //
@@ -86,17 +13,11 @@ quad& quad::operator=(const quad& pCopy) {
 /////////////////////////////////////////////////////////////////////
 
 /**
- * treelogic(pTrunkNode)
+ * treelogic()
  * 
- * constructor for our treelogic, requires the initial vector for our first trunk node
+ * constructor for our treelogic, our treebuilder sets up our tree
  **/
 treelogic::treelogic() {
-	// set some defaults
-	mLastNumOfVerts	= 1;
-	
-	// add our root vertex
-	addVertex(vec3(0.0, 0.0, 0.0)); // our tree "root"
-	
 	// default our shaders
 	mWireFrame = false;
 	mSimpleShader = NULL;
@@ -107,22 +28,18 @@ treelogic::treelogic() {
 	mVAO_APoints = 0;
 	mVBO_APoints = 0;
 	
-	mUpdateBuffers = true;
 	mVAO_Tree = 0;
 	mVAO_Leaves = 0;
 	mVBO_Verts = 0;
 	mVBO_TreeElements = 0;
 	mVBO_LeafElements = 0;
+	mPackedBuffer = false;
+	mShortTreeElements = false;
+	mShortLeafElements = false;
 	
 	// init our texture ID
 	mBarkTextID = 0;
 	mLeafTextID = 0;
-	
-	// tree generation info
-	mMinRadius = 0.4f;
-	mRadiusFactor = 1.0f / 400.0f;
-	mLeafSize.x = 20.0f;
-	mLeafSize.y = 30.0f;
 };
 
 treelogic::~treelogic() {
@@ -195,91 +112,6 @@ void treelogic::setWireframe(bool pWireframe) {
 	mWireFrame = pWireframe;
 };
 
-float treelogic::minRadius() {
-	return mMinRadius;
-};
-
-void treelogic::setMinRadius(float pRadius) {
-	mMinRadius = pRadius;
-};
-
-float treelogic::radiusFactor() {
-	return mRadiusFactor;
-};
-
-void treelogic::setRadiusFactor(float pFactor) {
-	mRadiusFactor = pFactor;
-};
-
-/////////////////////////////////////////////////////////////////////
-// helpers
-/////////////////////////////////////////////////////////////////////
-
-/**
- * randf(pMin, pMax)
- *
- * This method generates a random floating point number between min
- * and max
- **/
-float treelogic::randf(float pMin, float pMax) {
-	float randomNumber;
-	
-	randomNumber = rand() % 100000; // random number between 0 and 100000
-	randomNumber /= 100000; // scale to 0.0 - 1.0
-	randomNumber *= (pMax - pMin); // scale to our delta
-	
-	return randomNumber + pMin; // and return a number between min and max
-};
-
-/**
- * addVertex(pVertex)
- *
- * Adds a vertex to our vertex array (and initializes a normal and texture coord)
- **/
-unsigned long treelogic::addVertex(const vec3& pVertex) {
-	mVertices.push_back(pVertex);
-	mNormals.push_back(pVertex.normalized()); // just for now, this will be updates
-	mTexCoords.push_back(vec2(0.0f, 0.0f));
-	
-	// make sure we update our buffers
-	mUpdateBuffers = true;
-
-	return mVertices.size()-1;
-};
-
-/**
- * remVertex(pIndex)
- *
- * Removes the vertex at index pIndex and updates related arrays
- **/
-void treelogic::remVertex(unsigned long pIndex) {
-	mVertices.erase(mVertices.begin() + pIndex);
-	mNormals.erase(mNormals.begin() + pIndex);
-	mTexCoords.erase(mTexCoords.begin() + pIndex);
-	
-	// adjust our other nodes
-	for (unsigned long n = 0; n < mNodes.size(); n++) {
-		if (mNodes[n].a > pIndex) mNodes[n].a--;
-		if (mNodes[n].b > pIndex) mNodes[n].b--;
-	};
-	
-	// adjust our elements
-	for (unsigned long e = 0; e < mTreeElements.size(); e++) {
-		for (int i = 0; i < 4; i++) {
-			if (mTreeElements[e].v[i] > pIndex) mTreeElements[e].v[i]--;
-		};
-	};
-
-	for (unsigned long e = 0; e < mLeafElements.size(); e++) {
-		for (int i = 0; i < 3; i++) {
-			if (mLeafElements[e].v[i] > pIndex) mLeafElements[e].v[i]--;
-		};
-	};
-	
-	// make sure we update our buffers
-	mUpdateBuffers = true;
-};
-
 /////////////////////////////////////////////////////////////////////
 // Matrices
 /////////////////////////////////////////////////////////////////////
@@ -308,597 +140,6 @@ void treelogic::setModel(const mat4& pModel) {
 	mModel = pModel;
 };
 
-/////////////////////////////////////////////////////////////////////
-// tree generation code
-/////////////////////////////////////////////////////////////////////
-
-/**
- * growBrach(pFromVertex, pTo)
- *
- * This method will grow a branch from a given vertex
- *
- * pFromVertex - index of vertex to grow from
- * pTo         - location of new vertex to branch to
- *
- **/
-unsigned long treelogic::growBranch(unsigned long pFromVertex, vec3 pTo) {
-	int	parent = -1;
-	
-	// Find our parent
-	for (unsigned long p = 0; p < mNodes.size() && parent == -1; p++) {
-		if (mNodes[p].b == pFromVertex) {
-			parent = p;
-		};
-	};
-	
-	if (parent != -1) {
-		// check our vector from our parent
-		vec3 parentVector = mVertices[mNodes[parent].b] - mVertices[mNodes[parent].a];
-		parentVector = parentVector.normalized();
-		
-		vec3 toVector = pTo - mVertices[mNodes[parent].b];
-		toVector = toVector.normalized();
-		
-		// check if we're backtracking, this can happen if we're "trapped" between two equal distanced but opposite attraction points
-		float dot = parentVector % toVector;
-		if (dot < -0.5f) {
-			// use a cross product of the two vectors 
-			pTo = mVertices[mNodes[parent].b] + (parentVector * toVector);
-		};		
-	};
-	
-	// add our new vertice
-	addVertex(pTo);
-	
-	// add our node
-	mNodes.push_back(treenode(pFromVertex, mVertices.size()-1, parent));
-	
-	// now update our count
-	while (parent != -1) {
-		mNodes[parent].childcount++;
-		parent = mNodes[parent].parent;
-	};
-	
-	return mVertices.size()-1;
-};
-
-/**
- * generateAttractionPoints(pCount, pNumOfPoints, pOuterRadius, pInnerRadius, pAspect, pOffsetY)
- * 
- * This method generates the attaction points for our tree. 
- * At this moment we've only got a single very simple generation of points based on a stretched hemisphere filled with random points.
- * The shape of our point cloud very much determines the look of our tree. 
- * Adding more complexity to this algorithm to steer the shape of the point cloud will become a target later on.
- *
- * pNumOfPoints - Number of attraction points (N)
- * pOuterRadius - Outer size of our point cloud
- * pInnerRadius - Inner size of our point cloud
- * pAspect      - Aspect ratio between height and width
- * pOffsetY     - Y offset
- * pClear    	- Clears our attraction points first
- **/
-void treelogic::generateAttractionPoints(unsigned long pNumOfPoints, float pOuterRadius, float pInnerRadius, float pAspect, float pOffsetY, bool pClear) {
-	// Seed our randomiser
-	srand (time(NULL));
-	
-	if (pClear) {
-		// Clear any existing points (shouldn't be any..)
-		mAttractionPoints.clear();		
-	};
-	
-	// Add random attraction points until we reached our goal
-	for (unsigned long i = 0; i < pNumOfPoints; i++) {
-		vec3 point;
-		
-		// random normalized vector for half a hemisphere
-		point.x = randf();
-		point.y = randf(0.0f, 1.0f);
-		point.z = randf();		
-		point = point.normalized();
-		
-		// Scale it up to a random radius and stretch if needed
-		point *= ((pOuterRadius - pInnerRadius) * randf(0.0f, 1.0f)) + pInnerRadius;
-		point.y *= pAspect;
-		point.y += pOffsetY;
-		
-		// and add it to our buffer
-		mAttractionPoints.push_back(attractionPoint(point));
-	};
-};
-
-/**
- * doIteration(pCutOffDistance, pBranchSize)
- * 
- * This method performs one iteration of our tree generation logic and returns true if changes have been made.
- * Basically you should repeatidly call this method until it returns false
- * 
- * pMaxDistance    - maximum distance between attraction point and vertice for it to be considered (must be > pInnerRadius) (dk)
- * pBranchSize     - size with which we grow a branch (D)
- * pCutOffDistance - once the closest distance to an attraction point and a vertice becomes less then this we remove the attraction point (di, must be a multiple of pBranchSize)
- * pBias           - vector to add to simulate the effect the direction of growth
- **/
-bool treelogic::doIteration(float pMaxDistance, float pBranchSize, float pCutOffDistance, vec3 pBias) {
-	unsigned long numVerts = mVertices.size(); // need to know the number of vertices at the start of our process
-	unsigned long i, v;
-	std::vector<float> numOfAPoints;
-	std::vector<vec3> directions;
-	std::vector<unsigned long> lastClosest;
-	
-	// init our temporary buffers
-	for (v = 0; v < numVerts; v++) {
-		numOfAPoints.push_back(0.0);
-		directions.push_back(vec3(0.0f, 0.0f, 0.0f));
-		lastClosest.push_back(0);
-	};
-	
-	// find out what our closest vertice to each attraction points is:
-	i = 0;
-	while (i < mAttractionPoints.size()) { // use a while loop, we'll be removing points..
-		attractionPoint point = mAttractionPoints[i];
-		
-		// start with our current distance for our attraction point
-		vec3 delta = mVertices[point.closestVertice] - point.position;
-		float currentDistance = delta.length();
-		
-		// as our vertices haven't moved we only need to check any new vertices
-		for (v = mLastNumOfVerts; v < mVertices.size(); v++) {
-			delta = mVertices[v] - point.position;
-			float distance = delta.length();
-			if (distance < currentDistance) {
-				// this one is now our closest
-				point.closestVertice = v;
-				currentDistance = distance;
-			};
-		};
-		
-		if (currentDistance < pCutOffDistance) {
-			// we're done with this one...
-			mAttractionPoints.erase(mAttractionPoints.begin() + i);
-		} else {
-			// copy back our new closest vertice and advance...
-			mAttractionPoints[i].closestVertice = point.closestVertice;
-			
-			if (currentDistance < pMaxDistance) {
-				// count our vertice
-				numOfAPoints[point.closestVertice] += 1.0;
-				vec3 norm = mAttractionPoints[i].position - mVertices[point.closestVertice];
-				directions[point.closestVertice] += norm.normalized();
-				lastClosest[point.closestVertice] = i;
-			};
-			
-			// and advance
-			i++;
-		};
-	};
-	
-	// Update our last number of vertices
-	mLastNumOfVerts = numVerts;
-	
-	// Now check which vertices need to branch out...
-	for (v = 0; v < numVerts; v++) {		
-		if (numOfAPoints[v] > 0.0) {
-			vec3	vert = mVertices[v];
-			directions[v] /= numOfAPoints[v];
-			float	len = directions[v].length();
-			if (len < 0.1f) {
-				// this means that our points are at opposite ends, if so we ignore the last attraction point
-				
-				// get the vector to our last attraction point
-				vec3 norm = mAttractionPoints[lastClosest[v]].position - vert;
-
-				// take it out
-				directions[v] *= numOfAPoints[v];
-				directions[v] -= norm.normalized();
-				directions[v] /= numOfAPoints[v] - 1;
-				
-				// recalculate our length
-				len = directions[v].length();
-			};
-			
-			// and check our length again to be safe
-			if (len < 0.1f) {
-				// if all else fails, just add an arbitrary distance
-				vert += vec3(0.0, 1.0, 0.0);
-			} else {
-				directions[v] /= len;
-				directions[v] *= pBranchSize;				
-				vert += directions[v] + pBias;				
-			};
-			
-			growBranch(v, vert);			
-		};
-	};
-	
-	// as long as we still have attraction points left we must still be growing our tree
-	return mAttractionPoints.size() > 0; 
-};
-
-/**
- * optimiseNodes()
- *
- * This method will optimise nodes by joining nodes with small angles between them 
- * Note that this will invalidate our childcount, we won't update this rather leave
- * it up to the implementation whether to recount it or use the original counts
- * 
- **/
-void treelogic::optimiseNodes() {
-	unsigned long node = 0;
-	std::vector<long> children;
-	bool		newNode = true;
-	vec3		parentVector;
-	
-	while (node < mNodes.size()) {
-		int mergeWith = -1;
-		
-		// see if we need to update our vector because we've got a new node
-		if (newNode) {
-			parentVector = mVertices[mNodes[node].b] - mVertices[mNodes[node].a];
-			parentVector = parentVector.normalized();			
-		};
-		
-		// we need to find out how many children we have, we can only optimise if just one is found
-		children.clear();
-		for (unsigned long n = node+1; n < mNodes.size(); n++) {
-			if (mNodes[n].parent == node) {
-				children.push_back(n);
-			};
-		};
-		
-		// only one child? check if we need to merge
-		if (children.size() == 1) {
-			vec3	childVector = mVertices[mNodes[children[0]].b] - mVertices[mNodes[children[0]].a];
-			childVector = childVector.normalized();
-			
-			// use dot product, this gives our cosine, the closer to 1.0 the more the vectors match direction
-			float dot = parentVector % childVector;
-			if (dot > 0.995) {
-				mergeWith = children[0];
-			};
-		};
-		
-		// and merge
-		if (mergeWith != -1) {
-			unsigned long eraseVertice = mNodes[node].b; // should be same as mNodes[mergeWith].a, this we'll erase..
-			
-			// copy our node b from our merge node into our current node, then remove our merged node
-			mNodes[node].b = mNodes[mergeWith].b;			
-			mNodes.erase(mNodes.begin() + mergeWith);
-						
-			// adjust our other nodes
-			for (unsigned long n = 0; n < mNodes.size(); n++) {
-				if (mNodes[n].parent == mergeWith) { 
-					mNodes[n].parent = node;
-				} else if (mNodes[n].parent > mergeWith) {
-					mNodes[n].parent--;
-				};
-			};
-
-			// erase our vertice we no longer need
-			remVertex(eraseVertice);
-			
-			newNode = false; // we keep checking against our original vector!
-		} else {
-			node++;
-			newNode = true;
-		};
-	};
-};
-
-/**
- * createSlice(pCenter, pDir)
- *
- * This method creates a slice based on a center vertex and a direction vector
- *
- * pCenter		- the center of our slice
- * pPlaneNormal	- normal of our plane
- * pBitangent	- direction vector within the plane of our previous slice.
- * pSize		- size of our slice
- * pDistance	- distance "travelled" along our tree, we use this for texture coordinates
- *
- **/
-slice treelogic::createSlice(vec3 pCenter, vec3 pPlaneNormal, vec3 pBitangent, float pSize, float pDistance) {
-	slice newSlice;
-	mat3  rotate;
-	float distFact = 50.0f;
-	
-	// create our vertices counter clockwise
-	rotate.rotate(-90.0f, pPlaneNormal);
-	
-	// just a safety in case our bitangent lies parallel to our normal
-	if ((pBitangent % pPlaneNormal) > 0.99) {
-		pBitangent = vec3(1.0, 0.0, 0.0);
-		pBitangent.normalized();
-	};
-	
-	// we use the bitangent of the previous plane to calculate our tangent
-	// this lines up our starting vertex better
-	vec3 tangent = pPlaneNormal * pBitangent;
-	tangent = tangent.normalized();
-	
-	// now create our vertices
-	int p = addVertex(pCenter + (tangent * pSize));
-	mNormals[p] = tangent;
-	mTexCoords[p] = vec2(0, pDistance / distFact);
-	newSlice.p[0] = p;
-	
-	vec3 dirB = rotate * tangent;
-
-	p = addVertex(pCenter + (dirB * pSize));
-	mNormals[p] = dirB;
-	mTexCoords[p] = vec2(0.25, pDistance / distFact);
-	newSlice.p[1] = p;
-	
-	dirB = rotate * dirB;
-
-	p = addVertex(pCenter + (dirB * pSize));
-	mNormals[p] = dirB;
-	mTexCoords[p] = vec2(0.50, pDistance / distFact);
-	newSlice.p[2] = p;
-	
-	dirB = rotate * dirB;
-
-	p = addVertex(pCenter + (dirB * pSize));
-	mNormals[p] = dirB;
-	mTexCoords[p] = vec2(0.75, pDistance / distFact);
-	newSlice.p[3] = p;
-
-	// the last vertex is in the same location as the first but with different texture coords
-	p = addVertex(pCenter + (tangent * pSize));
-	mNormals[p] = tangent;
-	mTexCoords[p] = vec2(1.0, pDistance / distFact);
-	newSlice.p[4] = p;
-	
-	return newSlice;
-};
-
-/**
- * capSlice(pSlice)
- *
- * Puts a cap at the end of a branch
- **/
-void treelogic::capSlice(const slice& pSlice) {
-	quad newQuad;
-
-	newQuad.v[0] = pSlice.p[3];
-	newQuad.v[1] = pSlice.p[2];
-	newQuad.v[2] = pSlice.p[1];
-	newQuad.v[3] = pSlice.p[0];
-
-	mTreeElements.push_back(newQuad);
-
-	// make sure we update our buffers
-	mUpdateBuffers = true;
-};
-
-/**
- * joinTwoSlices(pA, pB)
- *
- * creates the quads that join these two slices
- * 
- **/
-void treelogic::joinTwoSlices(const slice& pA, const slice& pB) {
-	for (int i = 0; i < 4; i++) {
-		quad newQuad;
-		
-		newQuad.v[0] = pB.p[i];
-		newQuad.v[1] = pB.p[i+1];
-		newQuad.v[2] = pA.p[i+1];
-		newQuad.v[3] = pA.p[i];
-		
-		mTreeElements.push_back(newQuad);
-
-		// make sure we update our buffers
-		mUpdateBuffers = true;
-	};
-};
-
-/**
- * joinMultiSlices(pSliceCount, pSlices)
- * 
- * creates quads and vertices for a split in our branches
- *
- **/
-void treelogic::joinMultiSlices(long pSliceCount, slice* pSlices) {
-	// for now we cheat, we just join them, but this should become a binary join of these meshes...
-	for (long s = 1; s < pSliceCount; s++) {
-		for (int i = 0; i < 4; i++) {
-			quad newQuad;
-		
-			newQuad.v[0] = pSlices[s].p[i];
-			newQuad.v[1] = pSlices[s].p[i+1];
-			newQuad.v[2] = pSlices[0].p[i+1];
-			newQuad.v[3] = pSlices[0].p[i];
-		
-			mTreeElements.push_back(newQuad);
-
-			// make sure we update our buffers
-			mUpdateBuffers = true;
-		};		
-	};
-};
-
-/**
- * addLeaves(pCenter, pDirection)
- *
- * adds our branch
- **/
-void treelogic::addLeaves(vec3 pCenter, vec3 pTangent, vec3 pBiTangent) {
-	GLuint v[4];
-	
-	vec3 normal = pTangent * pBiTangent;
-	vec3 tangent = pTangent * mLeafSize.y * randf(0.8f,1.0f);
-	vec3 bitangent = pBiTangent * mLeafSize.x * randf(0.8f,1.0f);
-	vec3 vertex = pCenter;
-		
-	vertex -= bitangent * 0.5f;
-	v[0] = addVertex(vertex);
-	mNormals[v[0]] = normal;
-	mTexCoords[v[0]] = vec2(0.0f, 1.0f);
-
-	vertex += tangent;
-	v[1] = addVertex(vertex);
-	mNormals[v[1]] = normal;
-	mTexCoords[v[1]] = vec2(0.0f, 0.0f);
-
-	vertex += bitangent;
-	v[2] = addVertex(vertex);
-	mNormals[v[2]] = normal;
-	mTexCoords[v[2]] = vec2(1.0f, 0.0f);
-
-	vertex -= tangent;
-	v[3] = addVertex(vertex);
-	mNormals[v[3]] = normal;
-	mTexCoords[v[3]] = vec2(1.0f, 1.0f);
-	
-	triangle newTriangle;
-	
-	newTriangle.v[0] = v[0];
-	newTriangle.v[1] = v[1];
-	newTriangle.v[2] = v[2];
-	
-	mLeafElements.push_back(newTriangle);
-
-	newTriangle.v[0] = v[0];
-	newTriangle.v[1] = v[2];
-	newTriangle.v[2] = v[3];
-	
-	mLeafElements.push_back(newTriangle);
-};
-
-/** 
- * expandChildren(pParentNode, pOffset)
- *
- * This method expands the model based on the child nodes of a parent
- *
- * pParentNode	- the node for which we're expanding to its children (-1 means we're doing our root nodes)
- * pParentSlice	- the slice we created for our parent (note, empty if we're doing our rootnodes)
- * pOffset		- vector by which to offset what we're creating
- * pDistance	- distance "travelled" along our tree, we use this for texture coordinates
- *
- **/
-void treelogic::expandChildren(unsigned long pParentNode, const slice& pParentSlice, vec3 pOffset, float pDistance) {
-	// find out how many child nodes we have
-	std::vector<int> childNodes;
-	
-	for (int n = 0; n < mNodes.size(); n++) {
-		if (mNodes[n].parent == pParentNode) {
-			childNodes.push_back(n);
-		};
-	};
-
-	if (childNodes.size() == 0) {
-		if (pParentNode == -1) {
-			// nothing???
-		} else {
-			// cap our parent slice
-			capSlice(pParentSlice);
-
-			// and add our leaves
-			vec3	tangent	= mVertices[mNodes[pParentNode].b] - mVertices[mNodes[pParentNode].a];
-			tangent = tangent.normalized();
-			vec3	bitangent = tangent * mNormals[pParentSlice.p[0]];
-			bitangent = bitangent.normalized();
-			
-			addLeaves(mVertices[mNodes[pParentNode].a] + pOffset, tangent, bitangent);
-			addLeaves(mVertices[mNodes[pParentNode].a] + pOffset, tangent, bitangent * -1.0f);
-		};
-	} else if (childNodes.size() == 1) {
-		// we just need to create a slice at our root
-		int		node		= childNodes[0];
-		float	size		= mNodes[node].childcount;
-		size = (size * mRadiusFactor) + mMinRadius;
-		vec3	direction	= mVertices[mNodes[node].b] - mVertices[mNodes[node].a];
-		float	len			= direction.length();
-		direction /= len;
-		if (pParentNode != -1) {
-			vec3	parentDir	= mVertices[mNodes[pParentNode].b] - mVertices[mNodes[pParentNode].a];
-			direction += parentDir.normalized();
-			direction = direction.normalized();
-		};
-		
-		vec3	bitangent = mNormals[pParentSlice.p[3]];
-		slice	childSlice	= createSlice(mVertices[mNodes[node].a] + pOffset, direction, bitangent, size, pDistance);
-
-		if (pParentNode != -1) {
-			// join parent to child
-			joinTwoSlices(pParentSlice, childSlice);
-		};
-
-		expandChildren(node, childSlice, pOffset, pDistance + len);
-	} else {		
-		int		firstChild	= (pParentNode == -1 ? 0 : 1);
-		int		numSlices	= childNodes.size() + firstChild;
-		slice*	slices		= new slice[numSlices];
-		vec3	bitangent	= vec3(1.0f, 0.0f, 0.0f);
-		
-		if (pParentNode != -1) {
-			// draw our tree up to the point of our split
-			
-			float	size		= mNodes[pParentNode].childcount;
-			size = (size * mRadiusFactor) + mMinRadius;
-			vec3	direction	= mVertices[mNodes[pParentNode].b] - mVertices[mNodes[pParentNode].a];
-			float	len			= direction.length();
-			direction /= len;
-
-			bitangent = mNormals[pParentSlice.p[3]];
-			slices[0] = createSlice(mVertices[mNodes[pParentNode].b] + pOffset, direction, bitangent, size, pDistance);
-			bitangent = mNormals[slices[0].p[3]];
-
-			// join final piece
-			joinTwoSlices(pParentSlice, slices[0]);
-			
-			// now add in some room..
-			pOffset += direction * size;
-			pDistance += size;
-		};	
-		
-		for (int n = 0; n < childNodes.size(); n++) {
-			int		node		= childNodes[n];
-			float	size		= mNodes[node].childcount;
-			size = (size * mRadiusFactor) + mMinRadius;
-			vec3	direction	= mVertices[mNodes[node].b] - mVertices[mNodes[node].a];
-			float	len			= direction.length();
-			direction /= len;
-			if (pParentNode != -1) {
-				vec3	parentDir	= mVertices[mNodes[pParentNode].b] - mVertices[mNodes[pParentNode].a];
-				direction += parentDir.normalized();
-				direction = direction.normalized();
-			};
-			vec3	offset		= direction * size;
-
-			slices[n + firstChild] = createSlice(mVertices[mNodes[node].a] + pOffset + offset, direction, bitangent, size, pDistance + size);
-
-			expandChildren(node, slices[n + firstChild], pOffset + offset, pDistance + size + len);
-		};
-		
-		// now create joining piece
-		joinMultiSlices(numSlices, slices);
-		
-		delete slices;		
-	};
-	
-};
-
-/**
- * createModel()
- * 
- * This method will use our node tree to build a model of our tree
- *
- **/
-void treelogic::createModel() {
-	unsigned long	vertCount	= mVertices.size(); // remember how many vertices we have right now so we can remove these later on...
-
-	slice emptySlize;
-	expandChildren(-1, emptySlize, vec3(0.0f, 0.0f, 0.0f), 0.0f);
-	
-	// now remove our nodes and related vertices, we no longer need them...
-	for (unsigned long i = 0; i < vertCount; i++) {
-		remVertex(0);
-	};
-	mNodes.clear();
-};
-
-
 /////////////////////////////////////////////////////////////////////
 // shaders
 //
@@ -963,6 +204,57 @@ void treelogic::makeLeafShader() {
 // rendering
 /////////////////////////////////////////////////////////////////////
 
+/**
+ * bindVertexAttributes(pNumOfVerts)
+ *
+ * Points the attributes of our bound VAO at our vertex buffer, our positions go to 0, our normals to 1 and our
+ * texture coords to 2. Our packed vertices are interleaved, otherwise our buffer holds our separate arrays one after the other.
+ **/
+void treelogic::bindVertexAttributes(unsigned long pNumOfVerts) {
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO_Verts);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	
+	if (mPackedBuffer) {
+		GLsizei stride = mPackedVertices.stride();
+		glVertexAttribPointer(0, 3, mPackedVertices.format() == vertex_packed_half ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (GLvoid *) 0);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid *) mPackedVertices.normalOffset());
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid *) mPackedVertices.texCoordOffset());
+	} else {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) 0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) (sizeof(vec3) * pNumOfVerts));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), (GLvoid *) (2 * sizeof(vec3) * pNumOfVerts));
+	};
+};
+
+/**
+ * setVertexUniforms(pShader)
+ *
+ * Tells our shader how to decode our vertices
+ **/
+void treelogic::setVertexUniforms(shader* pShader) {
+	pShader->setIntUniform(pShader->uniform("octNormals"), mPackedBuffer ? 1 : 0);
+	pShader->setVec2Uniform(pShader->uniform("texScale"), vec2(1.0f, mPackedBuffer ? PACKED_TEXCOORD_RANGE : 1.0f));
+};
+
+/**
+ * drawElements(pMode, pNumOfIndices, pShort, pIndices)
+ *
+ * Draws the elements in our bound element buffer, if pShort is set that buffer holds pIndices and we draw each of
+ * its chunks from its own base vertex
+ **/
+void treelogic::drawElements(GLenum pMode, unsigned long pNumOfIndices, bool pShort, const indexbuffer& pIndices) {
+	if (pShort) {
+		const std::vector<indexchunk>& chunks = pIndices.chunks();
+		for (unsigned long c = 0; c < chunks.size(); c++) {
+			glDrawElementsBaseVertex(pMode, chunks[c].count, GL_UNSIGNED_SHORT, (GLvoid*) (chunks[c].first * sizeof(GLushort)), chunks[c].baseVertex);
+		};
+	} else {
+		glDrawElements(pMode, pNumOfIndices, GL_UNSIGNED_INT, 0);
+	};
+};
+
 /**
  * render()
  * 
@@ -973,6 +265,8 @@ void treelogic::render() {
 	unsigned long i;
 	unsigned long numOfVerts = mVertices.size();
 	
+	TREES_STATS_TIMER(mStats, stage_render);
+	
 	// OpenGL 3 requires us to have a vertex array buffer and store our data in vertex buffers. 
 	// These allow you to bind and set your buffers once and just enable the vertex array buffer to select them.
 	// Normally after loading a model into memory you would do this once way before your start your render loop. 
@@ -990,6 +284,8 @@ void treelogic::render() {
 	
 	// now load our buffers if we must
 	if (mUpdateBuffers && (numOfVerts > 0)) {		
+		TREES_TRACE_BEGIN("uploadVertices");
+		
 		// create a buffer for our vertices
 		if (mVBO_Verts == 0) {
 			// create our buffer
@@ -998,26 +294,30 @@ void treelogic::render() {
 
 		// bind our buffer
 		glBindBuffer(GL_ARRAY_BUFFER, mVBO_Verts);
-
-		// allocate our buffer (but no data yet), we're initially lying about static draw but that should be ok...
-		glBufferData(GL_ARRAY_BUFFER, (sizeof(vec3) + sizeof(vec3) + sizeof(vec2)) * numOfVerts, NULL, GL_STATIC_DRAW);			
 		
-		// copy our positions
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec3) * numOfVerts, mVertices.data());
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) 0);
-		
-		// copy our normals
-		glBufferSubData(GL_ARRAY_BUFFER, sizeof(vec3) * numOfVerts, sizeof(vec3) * numOfVerts, mNormals.data());
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) (sizeof(vec3) * numOfVerts));
-		
-		// copy our texture coords
-		glBufferSubData(GL_ARRAY_BUFFER, 2 * sizeof(vec3) * numOfVerts, sizeof(vec2) * numOfVerts, mTexCoords.data());
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), (GLvoid *) (2 * sizeof(vec3) * numOfVerts));
+		// once we have our mesh our mesher may have packed our vertices for us
+		mPackedBuffer = (mPackedVertices.format() != vertex_planar) && (mPackedVertices.size() == numOfVerts);
+		if (mPackedBuffer) {
+			// our vertices are already interleaved, we can load them as is
+			glBufferData(GL_ARRAY_BUFFER, mPackedVertices.stride() * numOfVerts, mPackedVertices.data(), GL_STATIC_DRAW);
+		} else {
+			// allocate our buffer (but no data yet), we're initially lying about static draw but that should be ok...
+			glBufferData(GL_ARRAY_BUFFER, (sizeof(vec3) + sizeof(vec3) + sizeof(vec2)) * numOfVerts, NULL, GL_STATIC_DRAW);			
+			
+			// copy our positions
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vec3) * numOfVerts, mVertices.data());
+			
+			// copy our normals
+			glBufferSubData(GL_ARRAY_BUFFER, sizeof(vec3) * numOfVerts, sizeof(vec3) * numOfVerts, mNormals.data());
+			
+			// copy our texture coords
+			glBufferSubData(GL_ARRAY_BUFFER, 2 * sizeof(vec3) * numOfVerts, sizeof(vec2) * numOfVerts, mTexCoords.data());
+		};
+		bindVertexAttributes(numOfVerts);
+		TREES_TRACE_END("uploadVertices");
 		
 		// and setup our elements buffer
+		TREES_TRACE_BEGIN("uploadElements");
 		if (mVBO_TreeElements == 0) {
 			// create our buffer
 			glGenBuffers(1, &mVBO_TreeElements);
@@ -1025,7 +325,11 @@ void treelogic::render() {
 		
 		// bind our buffer
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mVBO_TreeElements);	
-		if (mTreeElements.size() > 0) {
+		mShortTreeElements = (mTreeIndices.size() == 4 * mTreeElements.size()) && (mTreeIndices.size() > 0);
+		if (mShortTreeElements) {
+			// our mesher already wrote our elements as 16 bit indices, half the size
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * mTreeIndices.size(), mTreeIndices.data(), GL_STATIC_DRAW);
+		} else if (mTreeElements.size() > 0) {
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 4 * mTreeElements.size(), mTreeElements.data(), GL_STATIC_DRAW);			
 		} else if (mNodes.size() > 0) {
 			// Our nodes contain way to much data, but this time we'll need to copy
@@ -1041,6 +345,7 @@ void treelogic::render() {
 			
 			delete nodes;
 		};
+		TREES_TRACE_END("uploadElements");
 		
 		mUpdateBuffers = false;
 	};
@@ -1075,10 +380,11 @@ void treelogic::render() {
 		mTreeShader->setIntUniform(mTreeShader->uniform("treeTexture"), 0);
 		mTreeShader->setMat4Uniform(mTreeShader->uniform("mvp"), mProjection * mView * mModel);
 		mTreeShader->setMat3Uniform(mTreeShader->uniform("normalMat"), mModel.mat3x3());
+		setVertexUniforms(mTreeShader);
 
 		// in OpenGL we render these as patches and it goes through our tesselation shader
 		glPatchParameteri(GL_PATCH_VERTICES, 4);
-		glDrawElements(GL_PATCHES, mTreeElements.size() * 4, GL_UNSIGNED_INT, 0);
+		drawElements(GL_PATCHES, mTreeElements.size() * 4, mShortTreeElements, mTreeIndices);
 		
 		/* now its time for our leaves */
 		if (mLeafElements.size() > 0) {
@@ -1093,13 +399,7 @@ void treelogic::render() {
 			// create and load our buffers if we must
 			if (mVBO_LeafElements == 0) {
 				// our vertex buffer is loaded and should be unchanged or we wouldn't be here, reuse it..
-				glBindBuffer(GL_ARRAY_BUFFER, mVBO_Verts);
-				glEnableVertexAttribArray(0);
-				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) 0);
-				glEnableVertexAttribArray(1);
-				glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (GLvoid *) (sizeof(vec3) * numOfVerts));
-				glEnableVertexAttribArray(2);
-				glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), (GLvoid *) (2 * sizeof(vec3) * numOfVerts));
+				bindVertexAttributes(numOfVerts);
 				
 				// create our VBO for our leaf elements
 				glGenBuffers(1, &mVBO_LeafElements);
@@ -1108,7 +408,14 @@ void treelogic::render() {
 				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mVBO_LeafElements);	
 				
 				// and load our data
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * mLeafElements.size(), mLeafElements.data(), GL_STATIC_DRAW);			
+				TREES_TRACE_BEGIN("uploadLeafElements");
+				mShortLeafElements = (mLeafIndices.size() == 3 * mLeafElements.size());
+				if (mShortLeafElements) {
+					glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * mLeafIndices.size(), mLeafIndices.data(), GL_STATIC_DRAW);
+				} else {
+					glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * mLeafElements.size(), mLeafElements.data(), GL_STATIC_DRAW);			
+				};
+				TREES_TRACE_END("uploadLeafElements");
 			};
 
 			// setup our texture, texture 0 should still be the active texture
@@ -1126,9 +433,10 @@ void treelogic::render() {
 			mLeafShader->setIntUniform(mLeafShader->uniform("leafTexture"), 0);
 			mLeafShader->setMat4Uniform(mLeafShader->uniform("mvp"), mProjection * mView * mModel);
 			mLeafShader->setMat3Uniform(mLeafShader->uniform("normalMat"), mModel.mat3x3());
+			setVertexUniforms(mLeafShader);
 			
 			// and draw...
-			glDrawElements(GL_TRIANGLES, mLeafElements.size() * 3, GL_UNSIGNED_INT, 0);
+			drawElements(GL_TRIANGLES, mLeafElements.size() * 3, mShortLeafElements, mLeafIndices);
 		};
 		
 		// back to normal..
@@ -1169,7 +477,9 @@ void treelogic::render() {
 			glBindBuffer(GL_ARRAY_BUFFER, mVBO_APoints);
 			
 			// always reload our points, note that our position is at the start of our class so we can load it as is and just ignore the additional data
+			TREES_TRACE_BEGIN("uploadAttractionPoints");
 			glBufferData(GL_ARRAY_BUFFER, sizeof(attractionPoint) * mAttractionPoints.size(), mAttractionPoints.data(), GL_DYNAMIC_DRAW);
+			TREES_TRACE_END("uploadAttractionPoints");
 			glEnableVertexAttribArray(0);
 			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(attractionPoint), (GLvoid *) 0);
 			
@@ -0,0 +1,87 @@
+/********************************************************************
+ * treemesh holds the mesh of a finished tree
+ * 
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treemesh.h"
+
+/////////////////////////////////////////////////////////////////////
+// class for a triangle
+/////////////////////////////////////////////////////////////////////
+
+triangle::triangle() {
+	for (int i = 0; i < 3; i++) {
+		v[i] = 0;
+	};	
+};
+
+triangle::triangle(const triangle& pCopy) {
+	for (int i = 0; i < 3; i++) {
+		v[i] = pCopy.v[i];
+	};		
+};
+
+triangle& triangle::operator=(const triangle& pCopy) {
+	for (int i = 0; i < 3; i++) {
+		v[i] = pCopy.v[i];
+	};		
+	return (*this);
+};
+
+/////////////////////////////////////////////////////////////////////
+// class for a quad
+/////////////////////////////////////////////////////////////////////
+
+quad::quad() {
+	for (int i = 0; i < 4; i++) {
+		v[i] = 0;
+	};
+};
+
+quad::quad(const quad& pCopy) {
+	for (int i = 0; i < 4; i++) {
+		v[i] = pCopy.v[i];
+	};	
+};
+	
+quad& quad::operator=(const quad& pCopy) {
+	for (int i = 0; i < 4; i++) {
+		v[i] = pCopy.v[i];
+	};	
+	return (*this);
+};
+
+/////////////////////////////////////////////////////////////////////
+// treemesh
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * clear()
+ *
+ * Removes our mesh
+ **/
+void treemesh::clear() {
+	vertices.clear();
+	normals.clear();
+	texCoords.clear();
+	treeElements.clear();
+	leafElements.clear();
+	skeletonVertices.clear();
+	skeletonNodes.clear();
+};
+
+/**
+ * swap(pMesh)
+ *
+ * Swaps our mesh with pMesh without copying any of our data
+ **/
+void treemesh::swap(treemesh& pMesh) {
+	vertices.swap(pMesh.vertices);
+	normals.swap(pMesh.normals);
+	texCoords.swap(pMesh.texCoords);
+	treeElements.swap(pMesh.treeElements);
+	leafElements.swap(pMesh.leafElements);
+	skeletonVertices.swap(pMesh.skeletonVertices);
+	skeletonNodes.swap(pMesh.skeletonNodes);
+};
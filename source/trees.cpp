@@ -92,6 +92,14 @@ int main(void) {
 
 		// our new tree
 		treelogic * tree = new treelogic();
+		
+		// we want a different tree each time we run
+		tree->setSeed(time(NULL));
+		
+		// have our mesher pack our vertices and indices and order them for the vertex cache so we upload and render less data
+		tree->setVertexFormat(vertex_packed_float);
+		tree->setOptimiseVertexCache(true);
+		tree->setShortIndices(true);
 	
 		// add just one branch to start of with, you could build the start of a tree here manually
 		tree->growBranch(0, vec3(0.0, 10.0, 0.0));
@@ -0,0 +1,265 @@
+/********************************************************************
+ * treestats keeps timings and counters of our tree generation
+ *
+ * Our code records its stats through the TREES_STATS_ macros which
+ * compile to nothing unless TREES_STATS is defined.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treestats.h"
+
+/////////////////////////////////////////////////////////////////////
+// constructors/destructors
+/////////////////////////////////////////////////////////////////////
+
+treestats::treestats() {
+	reset();
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long long treestats::counter(statsCounters pCounter) const {
+	return mCounters[pCounter];
+};
+
+double treestats::stageTime(statsStages pStage) const {
+	return mStageTime[pStage];
+};
+
+unsigned long treestats::stageCalls(statsStages pStage) const {
+	return mStageCalls[pStage];
+};
+
+unsigned long treestats::numOfIterations() const {
+	return mIterations.size();
+};
+
+const iterationstats& treestats::iteration(unsigned long pIteration) const {
+	return mIterations[pIteration];
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+void treestats::reset() {
+	for (int c = 0; c < num_of_counters; c++) {
+		mCounters[c] = 0;
+		mIterationStart[c] = 0;
+	};
+	for (int s = 0; s < num_of_stages; s++) {
+		mStageTime[s] = 0.0;
+		mStageCalls[s] = 0;
+	};
+	mIterations.clear();
+	mIterationStartTime = 0.0;
+};
+
+/**
+ * add(pCounter, pValue)
+ *
+ * Adds pValue to our counter, this is safe to call from our worker threads
+ **/
+void treestats::add(statsCounters pCounter, unsigned long long pValue) {
+	__sync_add_and_fetch(&mCounters[pCounter], pValue);
+};
+
+void treestats::addTime(statsStages pStage, double pTime) {
+	mStageTime[pStage] += pTime;
+	mStageCalls[pStage]++;
+};
+
+/**
+ * beginIteration()
+ *
+ * Starts recording a new iteration, all counters added until endIteration() count towards it
+ **/
+void treestats::beginIteration() {
+	for (int c = 0; c < num_of_counters; c++) {
+		mIterationStart[c] = mCounters[c];
+	};
+	mIterationStartTime = now();
+};
+
+/**
+ * endIteration()
+ *
+ * Adds our current iteration to our list of iterations and its time to stage_iteration
+ **/
+void treestats::endIteration() {
+	iterationstats stats;
+	for (int c = 0; c < num_of_counters; c++) {
+		stats.counters[c] = mCounters[c] - mIterationStart[c];
+	};
+	stats.wallTime = now() - mIterationStartTime;
+
+	mIterations.push_back(stats);
+	addTime(stage_iteration, stats.wallTime);
+};
+
+/**
+ * toJSON(pJSON)
+ *
+ * Writes our totals, our stages and each iteration as a JSON object to pJSON
+ **/
+void treestats::toJSON(std::string& pJSON) const {
+	char text[256];
+
+	sprintf(text, "{\n\t\"enabled\": %s,\n\t\"counters\": {", enabled() ? "true" : "false");
+	pJSON = text;
+	for (int c = 0; c < num_of_counters; c++) {
+		sprintf(text, "%s\n\t\t\"%s\": %llu", c > 0 ? "," : "", counterName((statsCounters) c), mCounters[c]);
+		pJSON += text;
+	};
+
+	pJSON += "\n\t},\n\t\"stages\": {";
+	for (int s = 0; s < num_of_stages; s++) {
+		sprintf(text, "%s\n\t\t\"%s\": { \"calls\": %lu, \"ms\": %.3f }", s > 0 ? "," : "", stageName((statsStages) s), mStageCalls[s], mStageTime[s]);
+		pJSON += text;
+	};
+
+	pJSON += "\n\t},\n\t\"iterations\": [";
+	for (unsigned long i = 0; i < mIterations.size(); i++) {
+		const iterationstats& iteration = mIterations[i];
+
+		pJSON += (i > 0 ? ",\n\t\t{ " : "\n\t\t{ ");
+		for (int c = 0; c < num_of_counters; c++) {
+			sprintf(text, "\"%s\": %llu, ", counterName((statsCounters) c), iteration.counters[c]);
+			pJSON += text;
+		};
+		sprintf(text, "\"ms\": %.3f }", iteration.wallTime);
+		pJSON += text;
+	};
+	pJSON += (mIterations.size() > 0 ? "\n\t]\n}\n" : "]\n}\n");
+};
+
+/**
+ * writeJSON(pFileName)
+ *
+ * Writes our stats as JSON to pFileName, returns false if we couldn't write our file
+ **/
+bool treestats::writeJSON(const std::string& pFileName) const {
+	FILE* file = fopen(pFileName.c_str(), "w");
+	if (file == NULL) {
+		return false;
+	};
+
+	std::string json;
+	toJSON(json);
+	fwrite(json.data(), 1, json.size(), file);
+
+	bool success = (ferror(file) == 0);
+	if (fclose(file) != 0) {
+		success = false;
+	};
+
+	return success;
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * enabled()
+ *
+ * Returns true if we were built with TREES_STATS and our stats are being recorded
+ **/
+bool treestats::enabled() {
+#ifdef TREES_STATS
+	return true;
+#else
+	return false;
+#endif
+};
+
+/**
+ * now()
+ *
+ * Returns the current time in milliseconds
+ **/
+double treestats::now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+};
+
+/**
+ * peakProcessMemory()
+ *
+ * Returns the highest resident memory of our whole process so far in bytes, this also counts memory we've
+ * since freed and everything outside our trees
+ **/
+unsigned long treestats::peakProcessMemory() {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	};
+	
+#ifdef __APPLE__
+	// Mac OS X reports bytes
+	return usage.ru_maxrss;
+#else
+	// Linux reports kilobytes
+	return usage.ru_maxrss * 1024;
+#endif
+};
+
+const char* treestats::stageName(statsStages pStage) {
+	switch (pStage) {
+		case stage_iteration: {
+			return "iteration";
+		} break;
+		case stage_optimise: {
+			return "optimise";
+		} break;
+		case stage_model: {
+			return "model";
+		} break;
+		case stage_vertex_cache: {
+			return "vertex_cache";
+		} break;
+		case stage_render: {
+			return "render";
+		} break;
+		default: {
+			return "unknown";
+		} break;
+	};
+};
+
+const char* treestats::counterName(statsCounters pCounter) {
+	switch (pCounter) {
+		case counter_points_examined: {
+			return "points_examined";
+		} break;
+		case counter_points_killed: {
+			return "points_killed";
+		} break;
+		case counter_branches_grown: {
+			return "branches_grown";
+		} break;
+		case counter_distance_evaluations: {
+			return "distance_evaluations";
+		} break;
+		default: {
+			return "unknown";
+		} break;
+	};
+};
+
+/////////////////////////////////////////////////////////////////////
+// statstimer
+/////////////////////////////////////////////////////////////////////
+
+statstimer::statstimer(treestats& pStats, statsStages pStage) : mStats(pStats) {
+	mStage = pStage;
+	mStart = treestats::now();
+};
+
+statstimer::~statstimer() {
+	mStats.addTime(mStage, treestats::now() - mStart);
+};
@@ -0,0 +1,174 @@
+/********************************************************************
+ * treetrace records a timeline of our tree generation
+ *
+ * Each thread records its events into its own ring buffer so
+ * recording never takes a lock, we only lock the first time a thread
+ * records an event to add its buffer to our list.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "treetrace.h"
+
+#include <stdio.h>
+
+static pthread_once_t traceOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t traceKey;								// the tracebuffer of the current thread
+static pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;	// protects traceBuffers
+static std::vector<tracebuffer*> traceBuffers;				// buffers of all threads that have recorded events
+static unsigned long long traceStart = treetrace::now();	// our timestamps are relative to this
+
+static void createTraceKey() {
+	// we don't free our buffers when a thread exits, we still need to write them out
+	pthread_key_create(&traceKey, NULL);
+};
+
+/////////////////////////////////////////////////////////////////////
+// recording
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * threadBuffer()
+ *
+ * Returns the buffer of the current thread, creating it if this is the first event our thread records
+ **/
+tracebuffer* treetrace::threadBuffer() {
+	pthread_once(&traceOnce, createTraceKey);
+
+	tracebuffer* buffer = (tracebuffer*) pthread_getspecific(traceKey);
+	if (buffer == NULL) {
+		buffer = new tracebuffer();
+		buffer->count = 0;
+
+		pthread_mutex_lock(&traceMutex);
+		buffer->thread = traceBuffers.size();
+		traceBuffers.push_back(buffer);
+		pthread_mutex_unlock(&traceMutex);
+
+		pthread_setspecific(traceKey, buffer);
+	};
+
+	return buffer;
+};
+
+void treetrace::record(const char* pName, char pPhase) {
+	tracebuffer* buffer = threadBuffer();
+	traceevent& event = buffer->events[buffer->count & (TREETRACE_BUFFER_SIZE - 1)];
+
+	event.name = pName;
+	event.phase = pPhase;
+	event.timestamp = now() - traceStart;
+	buffer->count++;
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+void treetrace::begin(const char* pName) {
+	record(pName, 'B');
+};
+
+void treetrace::end(const char* pName) {
+	record(pName, 'E');
+};
+
+void treetrace::instant(const char* pName) {
+	record(pName, 'i');
+};
+
+/**
+ * write(pFileName)
+ *
+ * Writes the events of all our threads to pFileName in the trace event format. No thread should be
+ * recording events while we do this, call it once our tree is done.
+ **/
+bool treetrace::write(const std::string& pFileName) {
+	FILE* file = fopen(pFileName.c_str(), "w");
+	if (file == NULL) {
+		return false;
+	};
+
+	pthread_mutex_lock(&traceMutex);
+
+	// make sure we see everything our threads have written
+	__sync_synchronize();
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"trees\"}}");
+	for (unsigned long b = 0; b < traceBuffers.size(); b++) {
+		const tracebuffer* buffer = traceBuffers[b];
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"thread %lu\"}}", buffer->thread, buffer->thread);
+
+		// if our buffer has wrapped around our oldest event is the one we'd overwrite next
+		unsigned long first = (buffer->count > TREETRACE_BUFFER_SIZE ? buffer->count - TREETRACE_BUFFER_SIZE : 0);
+		for (unsigned long e = first; e < buffer->count; e++) {
+			const traceevent& event = buffer->events[e & (TREETRACE_BUFFER_SIZE - 1)];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"trees\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%lu%s}", event.name, event.phase, event.timestamp, buffer->thread, event.phase == 'i' ? ",\"s\":\"t\"" : "");
+		};
+	};
+	fprintf(file, "\n]}\n");
+
+	pthread_mutex_unlock(&traceMutex);
+
+	bool success = (ferror(file) == 0);
+	if (fclose(file) != 0) {
+		success = false;
+	};
+
+	return success;
+};
+
+/**
+ * clear()
+ *
+ * Forgets all events recorded so far, again no thread should be recording events while we do this
+ **/
+void treetrace::clear() {
+	pthread_mutex_lock(&traceMutex);
+	for (unsigned long b = 0; b < traceBuffers.size(); b++) {
+		traceBuffers[b]->count = 0;
+	};
+	pthread_mutex_unlock(&traceMutex);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * enabled()
+ *
+ * Returns true if we were built with TREES_TRACE and events are being recorded
+ **/
+bool treetrace::enabled() {
+#ifdef TREES_TRACE
+	return true;
+#else
+	return false;
+#endif
+};
+
+/**
+ * now()
+ *
+ * Returns the current time in microseconds
+ **/
+unsigned long long treetrace::now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return ((unsigned long long) tv.tv_sec * 1000000) + tv.tv_usec;
+};
+
+/////////////////////////////////////////////////////////////////////
+// tracescope
+/////////////////////////////////////////////////////////////////////
+
+tracescope::tracescope(const char* pName) {
+	mName = pName;
+	treetrace::begin(mName);
+};
+
+tracescope::~tracescope() {
+	treetrace::end(mName);
+};
@@ -0,0 +1,233 @@
+/********************************************************************
+ * vertextree is a k-d tree over the vertices of our tree skeleton
+ *
+ * Vertices are inserted incrementally as our tree grows. As we mostly
+ * insert along branches our k-d tree tends to form long chains so we
+ * rebuild a balanced tree whenever it becomes too deep.
+ *
+ * By Bastiaan Olij - 2015
+********************************************************************/
+
+#include "vertextree.h"
+
+#include <algorithm>
+
+vertextree::kdnodeless::kdnodeless(int pAxis) {
+	axis = pAxis;
+};
+
+bool vertextree::kdnodeless::operator()(const kdnode& pA, const kdnode& pB) const {
+	return coord(pA.position, axis) < coord(pB.position, axis);
+};
+
+vertextree::vertextree() {
+	mRoot = -1;
+	mBalancedCount = 0;
+	mMaxDepth = 0;
+};
+
+/////////////////////////////////////////////////////////////////////
+// properties
+/////////////////////////////////////////////////////////////////////
+
+unsigned long vertextree::size() const {
+	return mNodes.size();
+};
+
+unsigned long vertextree::memoryUsed() const {
+	return mNodes.capacity() * sizeof(kdnode);
+};
+
+/////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////
+
+float vertextree::coord(const vec3& pVector, int pAxis) {
+	switch (pAxis) {
+		case 0: return pVector.x;
+		case 1: return pVector.y;
+		default: return pVector.z;
+	};
+};
+
+/**
+ * buildBalanced(pFrom, pTo, pAxis)
+ *
+ * Builds a balanced subtree out of mNodes[pFrom] to mNodes[pTo-1] by splitting on the median.
+ * Our nodes are reordered in place and we return the index of the root of our subtree.
+ **/
+long vertextree::buildBalanced(unsigned long pFrom, unsigned long pTo, int pAxis) {
+	if (pFrom >= pTo) {
+		return -1;
+	};
+	
+	// find our median on this axis, everything before it ends up <= and everything after it >=
+	unsigned long median = pFrom + ((pTo - pFrom) / 2);
+	std::nth_element(mNodes.begin() + pFrom, mNodes.begin() + median, mNodes.begin() + pTo, kdnodeless(pAxis));
+	
+	int nextAxis = (pAxis + 1) % 3;
+	kdnode& node = mNodes[median];
+	node.axis = pAxis;
+	node.left = buildBalanced(pFrom, median, nextAxis);
+	node.right = buildBalanced(median + 1, pTo, nextAxis);
+	
+	node.maxVertex = node.vertex;
+	if ((node.left != -1) && (mNodes[node.left].maxVertex > node.maxVertex)) {
+		node.maxVertex = mNodes[node.left].maxVertex;
+	};
+	if ((node.right != -1) && (mNodes[node.right].maxVertex > node.maxVertex)) {
+		node.maxVertex = mNodes[node.right].maxVertex;
+	};
+	
+	return median;
+};
+
+/**
+ * insert(pPosition, pVertex)
+ *
+ * Adds a vertex to our tree without rebalancing
+ **/
+void vertextree::insert(const vec3& pPosition, unsigned long pVertex) {
+	kdnode node;
+	node.position = pPosition;
+	node.vertex = pVertex;
+	node.maxVertex = pVertex;
+	node.left = -1;
+	node.right = -1;
+	node.axis = 0;
+
+	long newNode = mNodes.size();
+	if (mRoot == -1) {
+		mNodes.push_back(node);
+		mRoot = newNode;
+		return;
+	};
+
+	// find our leaf
+	long parent = mRoot;
+	unsigned long depth = 1;
+	while (true) {
+		kdnode& check = mNodes[parent];
+		if (pVertex > check.maxVertex) {
+			check.maxVertex = pVertex;
+		};
+		
+		long* child = (coord(pPosition, check.axis) < coord(check.position, check.axis)) ? &check.left : &check.right;
+		if (*child == -1) {
+			*child = newNode;
+			node.axis = (check.axis + 1) % 3;
+			break;
+		};
+		parent = *child;
+		depth++;
+	};
+	
+	if (depth > mMaxDepth) {
+		mMaxDepth = depth;
+	};
+	
+	mNodes.push_back(node);
+};
+
+/////////////////////////////////////////////////////////////////////
+// interface
+/////////////////////////////////////////////////////////////////////
+
+/**
+ * clear()
+ *
+ * Removes all vertices from our tree
+ **/
+void vertextree::clear() {
+	mNodes.clear();
+	mRoot = -1;
+	mBalancedCount = 0;
+	mMaxDepth = 0;
+};
+
+/**
+ * update(pVertices)
+ *
+ * Adds any vertices we haven't seen yet to our tree. As vertices are only ever added while our tree grows
+ * we assume the ones we've already got are unchanged, if there are fewer vertices than we have we start over.
+ *
+ * pVertices	- the vertices of our tree
+ **/
+void vertextree::update(const std::vector<vec3>& pVertices) {
+	if (pVertices.size() < mNodes.size()) {
+		clear();
+	};
+	
+	for (unsigned long v = mNodes.size(); v < pVertices.size(); v++) {
+		insert(pVertices[v], v);
+	};
+	
+	// rebuild a balanced tree if we've become too deep or have doubled in size
+	unsigned long log2 = 0;
+	while ((1UL << log2) < mNodes.size()) {
+		log2++;
+	};
+	if ((mMaxDepth > 2 * log2 + 8) || (mNodes.size() >= 2 * mBalancedCount)) {
+		mBalancedCount = mNodes.size();
+		mMaxDepth = log2 + 1;
+		mRoot = buildBalanced(0, mNodes.size(), 0);
+	};
+};
+
+/**
+ * findClosest(pPosition, pFirstVertex, pClosest, pDistance, pRadius, pStack)
+ *
+ * Finds the vertex closest to pPosition. We only replace pClosest if we find a vertex that is closer,
+ * or equally close with a lower index, so the outcome is the same as testing each vertex in order.
+ * Vertices further away than pRadius may be skipped. Returns the number of vertices we calculated the distance to.
+ *
+ * pPosition	- position we're searching from
+ * pFirstVertex	- vertices with a lower index are ignored, subtrees containing only such vertices are skipped
+ * pClosest		- closest vertex found so far, updated
+ * pDistance	- distance to pClosest, updated
+ * pRadius		- we only guarantee finding our closest vertex if it lies within this radius
+ * pStack		- scratch buffer for our traversal so we can search from multiple threads
+ **/
+unsigned long vertextree::findClosest(const vec3& pPosition, unsigned long pFirstVertex, unsigned long& pClosest, float& pDistance, float pRadius, std::vector<long>& pStack) const {
+	unsigned long tested = 0;
+	
+	pStack.clear();
+	if (mRoot != -1) {
+		pStack.push_back(mRoot);
+	};
+	
+	while (!pStack.empty()) {
+		const kdnode& node = mNodes[pStack.back()];
+		pStack.pop_back();
+		
+		if (node.maxVertex < pFirstVertex) {
+			// nothing in this subtree we need to check
+			continue;
+		};
+		
+		if (node.vertex >= pFirstVertex) {
+			vec3 delta = node.position - pPosition;
+			float distance = delta.length();
+			tested++;
+			if ((distance < pDistance) || ((distance == pDistance) && (node.vertex < pClosest))) {
+				pClosest = node.vertex;
+				pDistance = distance;
+			};
+		};
+		
+		// any vertex on the far side of our split is at least as far away as our split plane
+		float diff = coord(pPosition, node.axis) - coord(node.position, node.axis);
+		long nearChild = (diff < 0.0f ? node.left : node.right);
+		long farChild = (diff < 0.0f ? node.right : node.left);
+		
+		if ((farChild != -1) && (fabs(diff) <= pDistance) && (fabs(diff) <= pRadius)) {
+			pStack.push_back(farChild);
+		};
+		if (nearChild != -1) {
+			// push our near child last so we search it first
+			pStack.push_back(nearChild);
+		};
+	};
+	
+	return tested;
+};